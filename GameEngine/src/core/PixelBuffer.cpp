@@ -0,0 +1,73 @@
+#include "PixelBuffer.h"
+
+PixelBufferRing::PixelBufferRing(size_t capacity)
+	:m_Capacity(capacity)
+{
+	// Slots start on cache lines
+	m_SlotSize = (m_Capacity * 4 + 63) / 64 * 64;
+
+	// Coherent, so pixels written by the CPU need no explicit flush before the upload.
+	// Readable too, a frame buffer moved out of the ring copies its pixels back
+	const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &m_RendererID);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_RendererID);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_SlotSize * SLOTS, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+	m_Mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_SlotSize * SLOTS, flags));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!m_Mapped)
+		std::cout << "ERROR\nFAILED TO MAP PIXEL BUFFER\n";
+}
+
+PixelBufferRing::~PixelBufferRing()
+{
+	for (GLsync fence : m_Fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+
+	if (m_Mapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_RendererID);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &m_RendererID);
+}
+
+int PixelBufferRing::Find(const void* data) const
+{
+	for (int slot = 0; slot < SLOTS; ++slot)
+	{
+		if (data == Data(slot))
+			return slot;
+	}
+	return -1;
+}
+
+void PixelBufferRing::Upload(int slot, Texture& texture, unsigned int width, unsigned int height)
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_RendererID);
+	texture.UpdateFromUnpackBuffer(slot * m_SlotSize, width, height);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (m_Fences[slot])
+		glDeleteSync(m_Fences[slot]);
+	m_Fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void PixelBufferRing::Wait(int slot)
+{
+	if (!m_Fences[slot])
+		return;
+
+	// Flushes on the first try, so the fence is sure to be signaled eventually
+	GLenum result = glClientWaitSync(m_Fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(m_Fences[slot], 0, 1000000000);
+
+	glDeleteSync(m_Fences[slot]);
+	m_Fences[slot] = nullptr;
+}
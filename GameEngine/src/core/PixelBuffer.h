@@ -0,0 +1,44 @@
+#pragma once
+#include <GL/glew.h>
+#include <array>
+
+#include "Texture.h"
+
+// Pixel unpack buffer split in SLOTS frames and persistently mapped, the CPU
+// writes its pixels straight into memory the driver uploads textures from.
+// A slot is fenced when its upload is issued and must be waited on before
+// it is written again
+class PixelBufferRing
+{
+public:
+	static constexpr int SLOTS = 3;
+
+	// Every slot holds capacity RGBA8 pixels
+	explicit PixelBufferRing(size_t capacity);
+	~PixelBufferRing();
+
+	PixelBufferRing(const PixelBufferRing&) = delete;
+	PixelBufferRing& operator=(const PixelBufferRing&) = delete;
+
+	// Needs immutable buffer storage, core since OpenGL 4.4
+	static bool IsSupported() { return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage; }
+	// False when the storage could not be allocated or mapped, the ring is unusable then
+	bool IsMapped() const { return m_Mapped != nullptr; }
+
+	unsigned char* Data(int slot) const { return m_Mapped + slot * m_SlotSize; }
+	size_t GetCapacity() const { return m_Capacity; }
+	// Slot starting at data, -1 when data is not in the ring
+	int Find(const void* data) const;
+
+	// Copies the first width x height pixels of the slot into the texture and fences the slot
+	void Upload(int slot, Texture& texture, unsigned int width, unsigned int height);
+	// Blocks until the last upload of the slot was done
+	void Wait(int slot);
+
+private:
+	unsigned int m_RendererID = 0;
+	unsigned char* m_Mapped = nullptr;
+	size_t m_Capacity = 0;
+	size_t m_SlotSize = 0;
+	std::array<GLsync, SLOTS> m_Fences{};
+};
@@ -0,0 +1,135 @@
+#include "SwizzledImage.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+SwizzledImage::SwizzledImage(const unsigned char* pixels, unsigned int width, unsigned int height, int components)
+{
+	constexpr unsigned int B = SwizzledLevel::BLOCK_SIZE;
+
+	// Sizes of the whole chain first, one allocation holds it
+	for (;;)
+	{
+		SwizzledLevel level;
+		level.width = width;
+		level.height = height;
+		level.blocksX = (width + B - 1) / B;
+		level.blocksY = (height + B - 1) / B;
+		m_Size += level.Size();
+		m_Levels.push_back(level);
+
+		if (width == 1 && height == 1)
+			break;
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	m_Texels.reset(static_cast<uint32_t*>(::operator new[](m_Size * sizeof(uint32_t), std::align_val_t(64))));
+
+	// Levels are whole blocks, so each one starts on a cache line
+	uint32_t* texels = m_Texels.get();
+	for (auto& level : m_Levels)
+	{
+		level.texels = texels;
+		texels += level.Size();
+	}
+
+	SwizzledLevel& base = m_Levels[0];
+	for (unsigned int y = 0; y < base.height; ++y)
+	{
+		const unsigned char* row = pixels + (size_t)y * base.width * components;
+		for (unsigned int x = 0; x < base.width; ++x)
+		{
+			const unsigned char* p = row + (size_t)x * components;
+
+			uint32_t r = p[0], g = p[0], b = p[0], a = 255;
+			if (components >= 3)
+			{
+				g = p[1];
+				b = p[2];
+			}
+			if (components == 2 || components == 4)
+				a = p[components - 1];
+
+			base.Store(x, y, r | g << 8 | b << 16 | a << 24);
+		}
+	}
+	FillPadding(base);
+
+	for (unsigned int level = 0; level + 1 < m_Levels.size(); ++level)
+		Downsample(level);
+}
+
+namespace
+{
+	// Averages of the 2x2 boxes of a 4 texels wide, 2 rows high strip of a block,
+	// the two results are in the low 8 bytes
+	inline __m128i Box2x2(__m128i row0, __m128i row1)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		// Texels 0 and 1 widened to 16 bits in lo, 2 and 3 in hi, summed over the rows
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpacklo_epi8(_mm_srli_si128(row0, 8), zero), _mm_unpacklo_epi8(_mm_srli_si128(row1, 8), zero));
+
+		// Then over the columns: 0 + 1 and 2 + 3, rounded
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+
+		return _mm_packus_epi16(sum, sum);
+	}
+}
+
+void SwizzledImage::Downsample(unsigned int level)
+{
+	const SwizzledLevel& src = m_Levels[level];
+	SwizzledLevel& dst = m_Levels[level + 1];
+
+	// A block of the destination is made from 2x2 blocks of the source. Blocks
+	// past the last one of the source only land in the padding of the
+	// destination, the last one is read again instead
+	#pragma omp parallel for schedule(static) if (dst.blocksY >= 16)
+	for (int by = 0; by < (int)dst.blocksY; ++by)
+	{
+		for (unsigned int bx = 0; bx < dst.blocksX; ++bx)
+		{
+			uint32_t* out = dst.Block(bx, by);
+
+			for (unsigned int sy = 0; sy < 2; ++sy)
+			{
+				const unsigned int srcY = std::min(by * 2 + sy, src.blocksY - 1);
+				const __m128i* left = (const __m128i*)src.Block(std::min(bx * 2, src.blocksX - 1), srcY);
+				const __m128i* right = (const __m128i*)src.Block(std::min(bx * 2 + 1, src.blocksX - 1), srcY);
+
+				// Rows 0-1 and 2-3 of the source blocks give two rows of the destination
+				for (unsigned int r = 0; r < 2; ++r)
+				{
+					__m128i row = _mm_unpacklo_epi64(
+						Box2x2(_mm_load_si128(left + r * 2), _mm_load_si128(left + r * 2 + 1)),
+						Box2x2(_mm_load_si128(right + r * 2), _mm_load_si128(right + r * 2 + 1)));
+					_mm_store_si128((__m128i*)out + sy * 2 + r, row);
+				}
+			}
+		}
+	}
+
+	FillPadding(dst);
+}
+
+void SwizzledImage::FillPadding(SwizzledLevel& level)
+{
+	constexpr unsigned int B = SwizzledLevel::BLOCK_SIZE;
+	const unsigned int paddedWidth = level.blocksX * B;
+	const unsigned int paddedHeight = level.blocksY * B;
+
+	for (unsigned int y = 0; y < level.height; ++y)
+	{
+		const uint32_t last = level.Fetch(level.width - 1, y);
+		for (unsigned int x = level.width; x < paddedWidth; ++x)
+			level.Store(x, y, last);
+	}
+
+	for (unsigned int y = level.height; y < paddedHeight; ++y)
+		for (unsigned int x = 0; x < paddedWidth; ++x)
+			level.Store(x, y, level.Fetch(x, level.height - 1));
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+// One level of a SwizzledImage, tiled in 4x4 blocks. A block is 64 bytes, one
+// cache line, and the blocks of a block row follow each other, so the 2x2 and
+// 4x4 footprints of the filters stay within one or two lines where a row major
+// layout touches a line per texel row
+struct SwizzledLevel
+{
+	static constexpr unsigned int BLOCK_SIZE = 4;
+
+	uint32_t* texels = nullptr;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int blocksX = 0;
+	unsigned int blocksY = 0;
+
+	size_t Offset(unsigned int x, unsigned int y) const
+	{
+		return ((size_t)(y / BLOCK_SIZE) * blocksX + x / BLOCK_SIZE) * (BLOCK_SIZE * BLOCK_SIZE)
+			+ (y % BLOCK_SIZE) * BLOCK_SIZE + x % BLOCK_SIZE;
+	}
+
+	// r in the lowest byte
+	uint32_t Fetch(unsigned int x, unsigned int y) const { return texels[Offset(x, y)]; }
+	void Store(unsigned int x, unsigned int y, uint32_t rgba) { texels[Offset(x, y)] = rgba; }
+
+	uint32_t* Block(unsigned int bx, unsigned int by) const { return texels + ((size_t)by * blocksX + bx) * (BLOCK_SIZE * BLOCK_SIZE); }
+	size_t Size() const { return (size_t)blocksX * blocksY * BLOCK_SIZE * BLOCK_SIZE; }
+};
+
+// RGBA8 texels of a CPU sampled texture with its whole mip chain down to 1x1,
+// every level in one allocation. A level is half the size of the previous one,
+// rounded down, and every texel is the average of a 2x2 box of it
+class SwizzledImage
+{
+public:
+	SwizzledImage() = default;
+	// Row major pixels of 1 to 4 components, missing ones are taken from the
+	// first (gray) or set to opaque
+	SwizzledImage(const unsigned char* pixels, unsigned int width, unsigned int height, int components);
+
+	const SwizzledLevel& Level(unsigned int level) const { return m_Levels[level]; }
+	unsigned int LevelCount() const { return (unsigned int)m_Levels.size(); }
+	size_t bytes() const { return m_Size * sizeof(uint32_t); }
+
+private:
+	// Fills the level below level from it
+	void Downsample(unsigned int level);
+	// Texels of the blocks past the edges of the level repeat the last row and
+	// column, so box filters can read whole blocks without bounds checks
+	static void FillPadding(SwizzledLevel& level);
+
+	struct AlignedDelete
+	{
+		void operator()(uint32_t* p) const { ::operator delete[](p, std::align_val_t(64)); }
+	};
+
+	std::unique_ptr<uint32_t[], AlignedDelete> m_Texels;
+	size_t m_Size = 0;
+	std::vector<SwizzledLevel> m_Levels;
+};
@@ -1,6 +1,7 @@
 #include "Texture.h"
 #include "stb_image.h"
 #include <format>
+#include <emmintrin.h>
 
 Texture::Texture(const std::string& path, 
 	Texture::Type type, 
@@ -10,11 +11,12 @@ Texture::Texture(const std::string& path,
 	:m_FilePath(path), type(type), filtering(filtering)
 {
 	stbi_set_flip_vertically_on_load(true);
-	glGenTextures(1, &m_RendererID);
 	m_LocalBuffer = stbi_load(m_FilePath.c_str(), &m_Width, &m_Height, &nrComponents, 0);
 
 	if (m_LocalBuffer)
 	{
+#ifndef CLOSE2GL_HEADLESS
+		glGenTextures(1, &m_RendererID);
 		glBindTexture(GL_TEXTURE_2D, m_RendererID);
 
 		GLenum format = 0;
@@ -29,13 +31,15 @@ Texture::Texture(const std::string& path,
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		SetGlobalFiltering(filtering, texParam);
+#else
+		// Without GL the pixels only live here
+		keepLocalBuffer = true;
+#endif
 
 		if (!keepLocalBuffer)
-			stbi_image_free(m_LocalBuffer);
-		else
 		{
-			m_MipMap = std::make_shared<MipMap>(m_LocalBuffer, m_Width, m_Height);
-			m_MipMap->MakeMipMap();
+			stbi_image_free(m_LocalBuffer);
+			m_LocalBuffer = nullptr;
 		}
 	}
 	else
@@ -50,10 +54,12 @@ Texture::Texture(const unsigned char* data, unsigned int width, unsigned int hei
 {
 	if (data)
 	{
+#ifndef CLOSE2GL_HEADLESS
 		glGenTextures(1, &m_RendererID);
 		glBindTexture(GL_TEXTURE_2D, m_RendererID);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_Width, m_Height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
 		SetGlobalFiltering(filtering, texParam);
+#endif
 	}
 	else
 	{
@@ -62,16 +68,12 @@ Texture::Texture(const unsigned char* data, unsigned int width, unsigned int hei
 	}
 }
 
+#ifndef CLOSE2GL_HEADLESS
 void Texture::Update(const unsigned char* data, unsigned int width, unsigned int height, Texture::Wrap texParam)
 {
 	if (data)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_RendererID);
-		if (width > m_Width || height > m_Height)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_Width, m_Height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		else
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		Upload(data, width, height);
 	}
 	else
 	{
@@ -80,15 +82,41 @@ void Texture::Update(const unsigned char* data, unsigned int width, unsigned int
 	}
 }
 
+void Texture::UpdateFromUnpackBuffer(size_t offset, unsigned int width, unsigned int height)
+{
+	Upload(reinterpret_cast<const void*>(offset), width, height);
+}
+
+void Texture::Upload(const void* pixels, unsigned int width, unsigned int height)
+{
+	glBindTexture(GL_TEXTURE_2D, m_RendererID);
+	// Reallocated on any change, a bigger texture would be stretched over the quad
+	if ((int)width != m_Width || (int)height != m_Height)
+	{
+		m_Width = width;
+		m_Height = height;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	// Raw textures are shown pixel for pixel, without mip maps
+}
+#endif
+
 Texture::~Texture()
 {
 #ifdef _DEBUG
 	if(m_FilePath != "")
 		std::cout << "Deleting texture [" << m_RendererID << "] of " << m_FilePath << "\n";
 #endif
+#ifndef CLOSE2GL_HEADLESS
 	glDeleteTextures(1, &m_RendererID);
+#endif
+	if (m_LocalBuffer)
+		stbi_image_free(m_LocalBuffer);
 }
 
+#ifndef CLOSE2GL_HEADLESS
 void Texture::Bind(unsigned int slot) const
 {
 	glActiveTexture(GL_TEXTURE0 + slot);
@@ -99,25 +127,30 @@ void Texture::Unbind() const
 {
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
+#endif
 
-cgl::vec3 Texture::GetPixelColorFromTextureBuffer(const unsigned char* const textureBuffer, unsigned int buffer_width, const unsigned int u, const unsigned int v)
+cgl::vec3 Texture::GetPixelColorFromTextureBuffer(const SwizzledLevel& image, const unsigned int u, const unsigned int v)
 {
-	auto currentPixelColor = &textureBuffer[(v * buffer_width + u) * 3];
-	return { ((float)currentPixelColor[0]) / 255.0f, ((float)currentPixelColor[1]) / 255.0f, ((float)currentPixelColor[2]) / 255.0f };
+	return TexelColor(image.Fetch(u, v));
 }
 
-cgl::vec3 Texture::BilinearFiltering(const unsigned char* const buffer, unsigned int buffer_width, float u, float v)
+cgl::vec3 Texture::BilinearFiltering(const SwizzledLevel& image, float u, float v)
 {
 	cgl::vec2 texelPos(u, v);
 	cgl::vec2 cellPos(std::floor(u), std::floor(v));
 
 	auto t = texelPos - cellPos;
 
+	const unsigned int x0 = std::min((unsigned int)cellPos.x, image.width - 1);
+	const unsigned int y0 = std::min((unsigned int)cellPos.y, image.height - 1);
+	const unsigned int x1 = std::min(x0 + 1, image.width - 1);
+	const unsigned int y1 = std::min(y0 + 1, image.height - 1);
+
 	// Samples
-	cgl::vec3 pixelTL = GetPixelColorFromTextureBuffer(buffer, buffer_width, cellPos.x + 0, cellPos.y + 0);
-	cgl::vec3 pixelTR = GetPixelColorFromTextureBuffer(buffer, buffer_width, cellPos.x + 1, cellPos.y + 0);
-	cgl::vec3 pixelBL = GetPixelColorFromTextureBuffer(buffer, buffer_width, cellPos.x + 0, cellPos.y + 1);
-	cgl::vec3 pixelBR = GetPixelColorFromTextureBuffer(buffer, buffer_width, cellPos.x + 1, cellPos.y + 1);
+	cgl::vec3 pixelTL = GetPixelColorFromTextureBuffer(image, x0, y0);
+	cgl::vec3 pixelTR = GetPixelColorFromTextureBuffer(image, x1, y0);
+	cgl::vec3 pixelBL = GetPixelColorFromTextureBuffer(image, x0, y1);
+	cgl::vec3 pixelBR = GetPixelColorFromTextureBuffer(image, x1, y1);
 
 	cgl::vec3 pixelTX = pixelTR * t.x + pixelTL * (1.0f - t.x);
 	cgl::vec3 pixelBX = pixelBR * t.x + pixelBL * (1.0f - t.x);
@@ -125,7 +158,94 @@ cgl::vec3 Texture::BilinearFiltering(const unsigned char* const buffer, unsigned
 	return pixelBX * t.y + pixelTX * (1.0f - t.y);
 }
 
-cgl::vec3 Texture::BicubicFiltering(const unsigned char* const buffer, unsigned int buffer_width, unsigned int buffer_height, float u, float v)
+namespace
+{
+	// a * (256 - w) + b * w, rounded, per 16 bits channel with weights in [0, 256].
+	// Channels are at most 255 so the sum stays below 2^16
+	inline __m128i Lerp16(__m128i a, __m128i b, __m128i w)
+	{
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(_mm_set1_epi16(256), w)), _mm_mullo_epi16(b, w));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+	}
+
+	// Lerps the 4 RGBA8 texels of a and b with one weight per texel
+	inline __m128i Lerp4(__m128i a, __m128i b, __m128i weights)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		// Every weight repeated over the 4 channels of its texel, 2 texels per half
+		__m128i w16 = _mm_packs_epi32(weights, weights);
+		w16 = _mm_unpacklo_epi16(w16, w16);
+		__m128i wLo = _mm_unpacklo_epi32(w16, w16);
+		__m128i wHi = _mm_unpackhi_epi32(w16, w16);
+
+		__m128i lo = Lerp16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), wLo);
+		__m128i hi = Lerp16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), wHi);
+		return _mm_packus_epi16(lo, hi);
+	}
+}
+
+void Texture::BilinearFiltering4(const SwizzledLevel* const levels[4], const float u[4], const float v[4], uint32_t out[4])
+{
+	alignas(16) uint32_t tl[4], tr[4], bl[4], br[4];
+	alignas(16) int fx[4], fy[4];
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const SwizzledLevel& level = *levels[i];
+
+		// 24.8 fixed point, the coordinates are never negative so truncating floors
+		const int x = (int)(std::max(u[i], 0.0f) * 256.0f);
+		const int y = (int)(std::max(v[i], 0.0f) * 256.0f);
+		fx[i] = x & 0xFF;
+		fy[i] = y & 0xFF;
+
+		const unsigned int x0 = std::min((unsigned int)(x >> 8), level.width - 1);
+		const unsigned int y0 = std::min((unsigned int)(y >> 8), level.height - 1);
+		const unsigned int x1 = std::min(x0 + 1, level.width - 1);
+		const unsigned int y1 = std::min(y0 + 1, level.height - 1);
+
+		tl[i] = level.Fetch(x0, y0);
+		tr[i] = level.Fetch(x1, y0);
+		bl[i] = level.Fetch(x0, y1);
+		br[i] = level.Fetch(x1, y1);
+	}
+
+	const __m128i wx = _mm_load_si128((const __m128i*)fx);
+	const __m128i top    = Lerp4(_mm_load_si128((const __m128i*)tl), _mm_load_si128((const __m128i*)tr), wx);
+	const __m128i bottom = Lerp4(_mm_load_si128((const __m128i*)bl), _mm_load_si128((const __m128i*)br), wx);
+
+	_mm_storeu_si128((__m128i*)out, Lerp4(top, bottom, _mm_load_si128((const __m128i*)fy)));
+}
+
+void Texture::TrilinearFiltering4(const float u[4], const float v[4], const float lod[4], uint32_t out[4]) const
+{
+	const SwizzledLevel* levels0[4];
+	const SwizzledLevel* levels1[4];
+	float u0[4], v0[4], u1[4], v1[4];
+	alignas(16) int t[4];
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const float level = std::floor(lod[i]);
+		levels0[i] = &GetLevel((unsigned int)level);
+		levels1[i] = &GetLevel((unsigned int)std::ceil(lod[i]));
+		t[i] = (int)((lod[i] - level) * 256.0f);
+
+		u0[i] = u[i] * levels0[i]->width;
+		v0[i] = v[i] * levels0[i]->height;
+		u1[i] = u[i] * levels1[i]->width;
+		v1[i] = v[i] * levels1[i]->height;
+	}
+
+	alignas(16) uint32_t color0[4], color1[4];
+	BilinearFiltering4(levels0, u0, v0, color0);
+	BilinearFiltering4(levels1, u1, v1, color1);
+
+	_mm_storeu_si128((__m128i*)out, Lerp4(_mm_load_si128((const __m128i*)color0), _mm_load_si128((const __m128i*)color1), _mm_load_si128((const __m128i*)t)));
+}
+
+cgl::vec3 Texture::BicubicFiltering(const SwizzledLevel& image, float u, float v)
 {
 	cgl::vec2 texelPos(u, v);
 	cgl::vec2 cellPos(std::floor(u), std::floor(v));
@@ -138,7 +258,7 @@ cgl::vec3 Texture::BicubicFiltering(const unsigned char* const buffer, unsigned
 	{
 		for (int x = 0; x < 4; ++x)
 		{
-			pixelSplines[y][x] = GetPixelColorFromTextureBuffer(buffer, buffer_width, std::clamp(cellPos.x + (x - 1), 0.0f, (float)buffer_width), std::clamp(cellPos.y + (y - 1), 0.0f, (float)buffer_height));
+			pixelSplines[y][x] = GetPixelColorFromTextureBuffer(image, std::clamp(cellPos.x + (x - 1), 0.0f, (float)image.width - 1), std::clamp(cellPos.y + (y - 1), 0.0f, (float)image.height - 1));
 		}
 	}
 
@@ -163,6 +283,7 @@ cgl::vec3 Texture::BicubicFiltering(const unsigned char* const buffer, unsigned
 	return { std::clamp(finalPixelColor.x, 0.0f, 1.0f), std::clamp(finalPixelColor.y, 0.0f, 1.0f), std::clamp(finalPixelColor.z, 0.0f, 1.0f) };
 }
 
+#ifndef CLOSE2GL_HEADLESS
 void Texture::SetGlobalFiltering(Texture::Filtering filtering, Texture::Wrap texParam)
 {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (GLint)texParam);
@@ -180,39 +301,36 @@ void Texture::SetFiltering() const
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)filtering);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)filtering);
 }
+#endif
 
-void MipMap::MakeMipMap()
+void Texture::BuildLevels() const
 {
-	unsigned int layer_width = m_Width;
-	unsigned int layer_height = m_Height;
-
-	m_MipMapLevels.push_back(m_Buffer);
-
-	while ((layer_width > 2 && layer_height > 2) && m_MipMapLevels.size() < 7)
+	std::call_once(m_LevelsBuilt, [this]
 	{
-		layer_width  = std::floor((float)layer_width  / 2.0f);
-		layer_height = std::floor((float)layer_height / 2.0f);
-
-		auto current_buffer = m_MipMapLevels.back();
-		unsigned char* new_layer_buffer = new unsigned char[layer_width * layer_height * 3];
-
-		for (unsigned int j = 0; j < (layer_height * 2); j += 2)
+		// The pixels of GL textures are freed once uploaded, they are read again
+		unsigned char* pixels = m_LocalBuffer;
+		if (!pixels && !m_FilePath.empty())
 		{
-			for (unsigned int i = 0; i < (layer_width * 2); i += 2)
-			{
-				cgl::vec3 pixelColor = Texture::BilinearFiltering(current_buffer, layer_width * 2, (float)i + 0.5f, (float)j + 0.5f);
-				new_layer_buffer[((j/2) * layer_height + (i/2)) * 3 + 0] = (unsigned char)(pixelColor.x * 255.0f);
-				new_layer_buffer[((j/2) * layer_height + (i/2)) * 3 + 1] = (unsigned char)(pixelColor.y * 255.0f);
-				new_layer_buffer[((j/2) * layer_height + (i/2)) * 3 + 2] = (unsigned char)(pixelColor.z * 255.0f);
-			}
+			int width = 0, height = 0, components = 0;
+			stbi_set_flip_vertically_on_load_thread(true);
+			pixels = stbi_load(m_FilePath.c_str(), &width, &height, &components, nrComponents);
 		}
-		m_MipMapLevels.push_back(new_layer_buffer);
-	}
+
+		if (!pixels)
+			return;
+
+		// The software rasterizer samples its own copy, whatever the component count
+		m_Texels = SwizzledImage(pixels, m_Width, m_Height, nrComponents);
+
+		if (pixels != m_LocalBuffer)
+			stbi_image_free(pixels);
+	});
 }
 
-float MipMap::GetMipMapLevel(float ds, float dt)
+float Texture::GetMipMapLevel(const cgl::vec2& ddx, const cgl::vec2& ddy)
 {
-	auto dist = std::sqrt((ds * ds) + (dt * dt));
-	auto level = std::log2(std::max(dist, 1.0f));
+	// log2 of the length, from the squared length without a square root
+	auto rho2 = std::max(ddx.dot(ddx), ddy.dot(ddy));
+	auto level = 0.5f * std::log2(std::max(rho2, 1.0f));
 	return level;
 }
@@ -5,24 +5,12 @@
 #endif
 #include <GL/glew.h>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "vec3.h"
 #include "vec2.h"
-
-struct MipMap
-{
-	unsigned char* m_Buffer;
-	unsigned int m_Width, m_Height;
-	std::vector<unsigned char*> m_MipMapLevels;
-	
-	MipMap(unsigned char* buf, unsigned int width, unsigned int height)
-		:m_Buffer(buf), m_Width(width), m_Height(height) {}
-
-	void MakeMipMap();
-	unsigned char* GetLevel(unsigned int level) { return m_MipMapLevels[level]; };
-	static float GetMipMapLevel(float ds, float dt);
-};
+#include "SwizzledImage.h"
 
 class Texture
 {
@@ -34,7 +22,12 @@ private:
 	unsigned char* m_LocalBuffer = nullptr;
 	int nrComponents = 0;
 
-	std::shared_ptr<MipMap> m_MipMap;
+	// Texels the software rasterizer samples, with their mip maps. Only made by
+	// BuildLevels, textures only drawn by GL never need them
+	mutable SwizzledImage m_Texels;
+	mutable std::once_flag m_LevelsBuilt;
+
+	void Upload(const void* pixels, unsigned int width, unsigned int height);
 
 public:
 
@@ -53,11 +46,14 @@ public:
 		Texture::Filtering filtering = Texture::Filtering::TRILLINEAR,
 		bool keepLocalBuffer = false);
 
+	// Raw RGBA8 pixels
 	Texture(const unsigned char* data, unsigned int width, unsigned int height, 
 		Texture::Filtering filtering = Texture::Filtering::NEAREST_NEIGHBOR, 
 		Texture::Wrap texParam = Texture::Wrap::MIRROR);
 
 	void Update(const unsigned char* data, unsigned int width, unsigned int height, Texture::Wrap texParam = Texture::Wrap::MIRROR);
+	// Same, reading the pixels at offset of the bound pixel unpack buffer
+	void UpdateFromUnpackBuffer(size_t offset, unsigned int width, unsigned int height);
 	const unsigned char* GetLocalBuffer() const { return m_LocalBuffer; }
 
 	~Texture();
@@ -74,12 +70,29 @@ public:
 	int GetID() const { return m_RendererID; };
 	std::string GetPath() const { return this->m_FilePath; };
 
-	static cgl::vec3 BilinearFiltering(const unsigned char* const buffer, unsigned int buffer_width, float u, float v);
-	static cgl::vec3 BicubicFiltering(const unsigned char* const buffer, unsigned int buffer_width, unsigned int buffer_height, float u, float v);
-
-	static cgl::vec3 GetPixelColorFromTextureBuffer(const unsigned char* const textureBuffer, unsigned int buffer_width, const unsigned int u, const unsigned int v);
-
-	std::shared_ptr<MipMap> GetMipMap() const { return m_MipMap; }
+	// u and v in texels of the image, reads past its last row and column are clamped
+	static cgl::vec3 BilinearFiltering(const SwizzledLevel& image, float u, float v);
+	static cgl::vec3 BicubicFiltering(const SwizzledLevel& image, float u, float v);
+
+	static cgl::vec3 GetPixelColorFromTextureBuffer(const SwizzledLevel& image, const unsigned int u, const unsigned int v);
+	// RGB of a packed RGBA8 texel in [0, 1]
+	static cgl::vec3 TexelColor(uint32_t texel) { return { (float)(texel & 0xFF) / 255.0f, (float)((texel >> 8) & 0xFF) / 255.0f, (float)((texel >> 16) & 0xFF) / 255.0f }; }
+
+	// Bilinear filtering of 4 points at once on the packed texels, with 8.8 fixed
+	// point weights. Each point reads its own level, u and v in its texels like
+	// BilinearFiltering, out is RGBA8 like the texels
+	static void BilinearFiltering4(const SwizzledLevel* const levels[4], const float u[4], const float v[4], uint32_t out[4]);
+	// u and v in [0, 1], lod of each point in [0, GetLevelCount() - 1]
+	void TrilinearFiltering4(const float u[4], const float v[4], const float lod[4], uint32_t out[4]) const;
+
+	// Makes the levels the first time, before the texture is sampled on the CPU.
+	// Only loaded textures have levels, raw ones are not sampled on the CPU
+	void BuildLevels() const;
+	const SwizzledLevel& GetLevel(unsigned int level) const { return m_Texels.Level(level); }
+	unsigned int GetLevelCount() const { return m_Texels.LevelCount(); }
+	// Isotropic level of detail for the change of the texel coordinates one pixel
+	// right and one pixel down, the longest of the two decides
+	static float GetMipMapLevel(const cgl::vec2& ddx, const cgl::vec2& ddy);
 
 	enum class Wrap
 	{
@@ -0,0 +1,154 @@
+#include "FrameTimes.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "IMGUI/imgui.h"
+
+FrameTimes::FrameTimes()
+{
+	m_Current.fill(NAN);
+}
+
+void FrameTimes::EndFrame()
+{
+	for (int s = 0; s < STAGE_COUNT; ++s)
+		m_Samples[s][m_Frames % CAPACITY] = m_Current[s];
+
+	m_Current.fill(NAN);
+	++m_Frames;
+}
+
+unsigned int FrameTimes::Window() const
+{
+	return (unsigned int)std::min<uint64_t>(m_Frames, (uint64_t)m_Window);
+}
+
+void FrameTimes::CopyWindow(STAGE stage, std::vector<float>& out) const
+{
+	const unsigned int count = Window();
+	out.clear();
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const float ms = m_Samples[stage][(m_Frames - count + i) % CAPACITY];
+		if (!std::isnan(ms))
+			out.push_back(ms);
+	}
+}
+
+FrameTimes::Summary FrameTimes::Summarize(STAGE stage) const
+{
+	std::vector<float> sorted;
+	CopyWindow(stage, sorted);
+	if (sorted.empty())
+		return {};
+
+	std::sort(sorted.begin(), sorted.end());
+
+	// Nearest rank
+	auto percentile = [&](float p)
+	{
+		size_t rank = (size_t)std::ceil(p * (float)sorted.size());
+		return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+	};
+
+	return { percentile(0.50f), percentile(0.95f), percentile(0.99f), sorted.back() };
+}
+
+bool FrameTimes::ExportCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+
+	file << "frame";
+	for (int s = 0; s < STAGE_COUNT; ++s)
+		file << ',' << StageName((STAGE)s) << "_ms";
+	file << '\n';
+
+	const unsigned int count = Window();
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const uint64_t frame = m_Frames - count + i;
+		file << frame;
+		// Absent stages are left empty
+		for (int s = 0; s < STAGE_COUNT; ++s)
+		{
+			file << ',';
+			if (!std::isnan(m_Samples[s][frame % CAPACITY]))
+				file << m_Samples[s][frame % CAPACITY];
+		}
+		file << '\n';
+	}
+
+	return (bool)file;
+}
+
+const char* FrameTimes::StageName(STAGE stage)
+{
+	switch (stage)
+	{
+	case FRAME:        return "frame";
+	case SCENE_UPDATE: return "scene_update";
+	case RASTER:       return "raster";
+	case UPLOAD:       return "upload";
+	case IMGUI:        return "imgui";
+	default:           return "";
+	}
+}
+
+void FrameTimes::OnImGui()
+{
+	ImGui::SliderInt("Frames", &m_Window, 10, (int)CAPACITY);
+
+	if (ImGui::BeginTable("Frame Times", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn("ms");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableSetupColumn("p99");
+		ImGui::TableSetupColumn("max");
+		ImGui::TableHeadersRow();
+
+		for (int s = 0; s < STAGE_COUNT; ++s)
+		{
+			const Summary summary = Summarize((STAGE)s);
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(StageName((STAGE)s));
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", summary.p50);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", summary.p95);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", summary.p99);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", summary.max);
+		}
+		ImGui::EndTable();
+	}
+
+	ImGui::Combo("Stage", &m_SelectedStage, "frame\0scene update\0raster\0upload\0imgui\0");
+
+	// Every frame of the window the stage is present in as a bar, a spike stands out
+	CopyWindow((STAGE)m_SelectedStage, m_Plot);
+	const float max = m_Plot.empty() ? 0.0f : *std::max_element(m_Plot.begin(), m_Plot.end());
+	ImGui::PlotHistogram("##Frames", m_Plot.data(), (int)m_Plot.size(), 0, "per frame", 0.0f, max, ImVec2(0, 80));
+
+	// Distribution of the same frames in 32 buckets from 0 to the max
+	constexpr int BUCKETS = 32;
+	float buckets[BUCKETS] = {};
+	for (float ms : m_Plot)
+		buckets[max > 0.0f ? std::min((int)(ms / max * BUCKETS), BUCKETS - 1) : 0] += 1.0f;
+
+	char overlay[64];
+	std::snprintf(overlay, sizeof(overlay), "0 - %.2f ms", max);
+	ImGui::PlotHistogram("##Distribution", buckets, BUCKETS, 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 80));
+
+	if (ImGui::Button("Export CSV"))
+	{
+		if (ExportCSV("close2gl_frame_times.csv"))
+			std::cout << "Wrote the last " << Window() << " frames to close2gl_frame_times.csv" << std::endl;
+		else
+			std::cout << "Could not write close2gl_frame_times.csv" << std::endl;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Rolling window of the frame times of the main loop, split by stage. Percentiles
+// over the window show the stutter an average hides, a single stall like a model
+// load stays visible in the plot until it leaves the window.
+// Stages overlap and do not add up to the frame: the upload is part of the scene
+// update, and so is the raster when the rasterizer is not asynchronous
+class FrameTimes
+{
+public:
+	enum STAGE { FRAME, SCENE_UPDATE, RASTER, UPLOAD, IMGUI, STAGE_COUNT };
+	static constexpr unsigned int CAPACITY = 4096;
+
+	struct Summary
+	{
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		float max = 0.0f;
+	};
+
+	FrameTimes();
+
+	// Milliseconds spent in the stage during the current frame, adds up
+	void Add(STAGE stage, double ms) { m_Current[stage] = (std::isnan(m_Current[stage]) ? 0.0f : m_Current[stage]) + (float)ms; }
+	// Closes the current frame. Stages not added to are absent from it, like the
+	// raster on frames that presented nothing new, and are left out of the summaries
+	void EndFrame();
+
+	// Over the frames of the last Window() ones the stage is present in
+	Summary Summarize(STAGE stage) const;
+	unsigned int Window() const;
+
+	// One row per frame of the window, oldest first
+	bool ExportCSV(const std::string& path) const;
+
+	void OnImGui();
+
+	static const char* StageName(STAGE stage);
+
+private:
+	// Samples of the stage of the window, oldest first, without the absent ones
+	void CopyWindow(STAGE stage, std::vector<float>& out) const;
+
+	// NaN when the stage is absent from the frame
+	std::array<std::array<float, CAPACITY>, STAGE_COUNT> m_Samples{};
+	std::array<float, STAGE_COUNT> m_Current;
+	uint64_t m_Frames = 0;
+
+	int m_Window = 300;
+	int m_SelectedStage = FRAME;
+	std::vector<float> m_Plot;
+};
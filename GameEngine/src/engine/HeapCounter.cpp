@@ -0,0 +1,35 @@
+#include "HeapCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local size_t allocations = 0;
+}
+
+size_t HeapCounter::Allocations()
+{
+	return allocations;
+}
+
+// Array and nothrow forms fall back to these
+void* operator new(size_t size)
+{
+	++allocations;
+
+	if (void* p = std::malloc(size != 0 ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
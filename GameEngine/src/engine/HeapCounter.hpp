@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts every call to the global operator new of the program, per thread. The
+// difference between two reads is the number of heap allocations the calling
+// thread made in between, whatever the other threads do meanwhile
+namespace HeapCounter
+{
+	size_t Allocations();
+}
@@ -0,0 +1,214 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		int64_t begin;
+		int64_t end;
+	};
+
+	// Fields are atomic so a reader may copy a slot while it is written, torn
+	// copies are thrown away after
+	struct Slot
+	{
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<int64_t> begin{ 0 };
+		std::atomic<int64_t> end{ 0 };
+	};
+
+	// Only its thread writes it. The count is published after the event, and a
+	// reader knows a copied event was overwritten meanwhile when the count went
+	// more than the capacity past it. The slot of the count itself may be being
+	// written, so it is counted as overwritten too
+	struct Ring
+	{
+		static constexpr uint64_t CAPACITY = 1 << 14;
+
+		std::array<Slot, CAPACITY> events;
+		std::atomic<uint64_t> written{ 0 };
+		uint32_t id = 0;
+		std::string name;
+	};
+
+	// Start times of the last frames, written by the thread of the main loop
+	struct FrameMarks
+	{
+		static constexpr uint64_t CAPACITY = 1024;
+
+		std::array<int64_t, CAPACITY> begins{};
+		std::atomic<uint64_t> written{ 0 };
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::mutex ringsMutex;
+	// Rings are never freed. The ring of a thread that ended can still be exported
+	// until a new thread reuses it, so threads coming and going, like the render
+	// thread or the OpenMP workers, do not keep adding rings
+	std::vector<std::unique_ptr<Ring>> rings;
+	std::vector<Ring*> freeRings;
+	FrameMarks frameMarks;
+
+	// Gives the ring of the thread back when the thread ends
+	struct RingOwner
+	{
+		Ring* ring = nullptr;
+
+		~RingOwner()
+		{
+			if (ring == nullptr)
+				return;
+
+			std::lock_guard lock(ringsMutex);
+			freeRings.push_back(ring);
+		}
+	};
+
+	Ring& ThreadRing()
+	{
+		thread_local RingOwner owner;
+		if (owner.ring == nullptr)
+		{
+			std::lock_guard lock(ringsMutex);
+			if (freeRings.empty())
+			{
+				rings.push_back(std::make_unique<Ring>());
+				owner.ring = rings.back().get();
+				owner.ring->id = (uint32_t)rings.size() - 1;
+			}
+			else
+			{
+				// Exports hold the lock, none is reading the events dropped here
+				owner.ring = freeRings.back();
+				freeRings.pop_back();
+				owner.ring->written.store(0, std::memory_order_relaxed);
+			}
+			owner.ring->name = "Thread " + std::to_string(owner.ring->id);
+		}
+		return *owner.ring;
+	}
+
+	// Events of the ring still intact, oldest first
+	std::vector<Event> CopyRing(const Ring& ring)
+	{
+		const uint64_t written = ring.written.load(std::memory_order_acquire);
+		const uint64_t first = written > Ring::CAPACITY ? written - Ring::CAPACITY : 0;
+
+		std::vector<Event> events;
+		events.reserve((size_t)(written - first));
+		for (uint64_t i = first; i < written; ++i)
+		{
+			const Slot& slot = ring.events[i % Ring::CAPACITY];
+			events.push_back({
+				slot.name.load(std::memory_order_relaxed),
+				slot.begin.load(std::memory_order_relaxed),
+				slot.end.load(std::memory_order_relaxed)
+			});
+		}
+
+		// Pairs with the fence of Record, a copied field of a newer event means the
+		// count read next includes that event
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t now = ring.written.load(std::memory_order_relaxed);
+		const uint64_t overwritten = now + 1 > Ring::CAPACITY ? now + 1 - Ring::CAPACITY : 0;
+		if (overwritten > first)
+			events.erase(events.begin(), events.begin() + (ptrdiff_t)std::min(overwritten - first, (uint64_t)events.size()));
+
+		return events;
+	}
+
+	// Trace times are microseconds, the nanoseconds go in the decimals
+	void WriteMicroseconds(std::ostream& out, int64_t ns)
+	{
+		out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+	}
+}
+
+int64_t Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Profiler::Record(const char* name, int64_t begin, int64_t end)
+{
+	Ring& ring = ThreadRing();
+	const uint64_t index = ring.written.load(std::memory_order_relaxed);
+
+	// The count of the previous event is published before any field of this one
+	std::atomic_thread_fence(std::memory_order_release);
+	Slot& slot = ring.events[index % Ring::CAPACITY];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.begin.store(begin, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	ring.written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::MarkFrame(int64_t begin)
+{
+	const uint64_t index = frameMarks.written.load(std::memory_order_relaxed);
+	frameMarks.begins[index % FrameMarks::CAPACITY] = begin;
+	frameMarks.written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	Ring& ring = ThreadRing();
+	std::lock_guard lock(ringsMutex);
+	ring.name = name;
+}
+
+unsigned int Profiler::CapturedFrames()
+{
+	return (unsigned int)std::min(frameMarks.written.load(std::memory_order_acquire), FrameMarks::CAPACITY);
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path, unsigned int frames)
+{
+	// The oldest mark may be overwritten while reading, one is kept as margin
+	const uint64_t marks = frameMarks.written.load(std::memory_order_acquire);
+	const uint64_t count = std::min<uint64_t>({ frames, marks, FrameMarks::CAPACITY - 1 });
+	const int64_t windowBegin = count > 0 ? frameMarks.begins[(marks - count) % FrameMarks::CAPACITY] : 0;
+
+	std::ofstream file(path);
+	if (!file)
+		return false;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool isFirst = true;
+
+	std::lock_guard lock(ringsMutex);
+	for (const auto& ring : rings)
+	{
+		file << (isFirst ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->id
+			<< ",\"args\":{\"name\":\"" << ring->name << "\"}}";
+		isFirst = false;
+
+		for (const Event& event : CopyRing(*ring))
+		{
+			if (event.end < windowBegin)
+				continue;
+
+			file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->id
+				<< ",\"ts\":";
+			WriteMicroseconds(file, event.begin);
+			file << ",\"dur\":";
+			WriteMicroseconds(file, event.end - event.begin);
+			file << '}';
+		}
+	}
+	file << "\n]}\n";
+
+	return (bool)file;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped zones recorded by every thread into a ring of its own. A thread only
+// writes its own ring, without locks, and the newest events of all threads can
+// be exported as a Chrome trace (chrome://tracing or ui.perfetto.dev)
+namespace Profiler
+{
+	// Nanoseconds since the profiler started
+	int64_t Now();
+
+	// name must outlive the profiler, zones are named with string literals
+	void Record(const char* name, int64_t begin, int64_t end);
+	// Marks the start of a frame of the main loop, windows of frames are taken from them
+	void MarkFrame(int64_t begin);
+	// Shown instead of the thread number in the trace
+	void SetThreadName(const char* name);
+
+	// Writes the zones of every thread since the start of the last frames frames,
+	// false when the file could not be written
+	bool ExportChromeTrace(const std::string& path, unsigned int frames);
+	// Frames that can still be exported
+	unsigned int CapturedFrames();
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name) : m_Name(name), m_Begin(Now()) {}
+		~Scope() { Record(m_Name, m_Begin, Now()); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	protected:
+		const char* m_Name;
+		int64_t m_Begin;
+	};
+
+	class FrameScope : public Scope
+	{
+	public:
+		FrameScope() : Scope("Frame") { MarkFrame(m_Begin); }
+	};
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::FrameScope PROFILE_CONCAT(profileFrame, __LINE__)
@@ -0,0 +1,74 @@
+#include "bounds.h"
+
+Frustum::Frustum(const glm::mat4& m)
+{
+	const glm::vec4 rows[4] = {
+		{ m[0][0], m[1][0], m[2][0], m[3][0] },
+		{ m[0][1], m[1][1], m[2][1], m[3][1] },
+		{ m[0][2], m[1][2], m[2][2], m[3][2] },
+		{ m[0][3], m[1][3], m[2][3], m[3][3] }
+	};
+	setPlanes(rows);
+}
+
+Frustum::Frustum(const cgl::mat4& m)
+{
+	const glm::vec4 rows[4] = {
+		{ m.mat[0][0], m.mat[0][1], m.mat[0][2], m.mat[0][3] },
+		{ m.mat[1][0], m.mat[1][1], m.mat[1][2], m.mat[1][3] },
+		{ m.mat[2][0], m.mat[2][1], m.mat[2][2], m.mat[2][3] },
+		{ m.mat[3][0], m.mat[3][1], m.mat[3][2], m.mat[3][3] }
+	};
+	setPlanes(rows);
+}
+
+void Frustum::setPlanes(const glm::vec4 rows[4])
+{
+	// Gribb and Hartmann, -w <= x, y, z <= w in clipping space
+	m_Planes[0] = rows[3] + rows[0]; // left
+	m_Planes[1] = rows[3] - rows[0]; // right
+	m_Planes[2] = rows[3] + rows[1]; // bottom
+	m_Planes[3] = rows[3] - rows[1]; // top
+	m_Planes[4] = rows[3] + rows[2]; // near
+	m_Planes[5] = rows[3] - rows[2]; // far
+
+	// Normalized so the sphere test gets real distances
+	for (auto& plane : m_Planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane /= length;
+	}
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	if (sphere.empty())
+		return false;
+
+	for (const auto& plane : m_Planes)
+	{
+		if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const
+{
+	if (box.empty())
+		return false;
+
+	for (const auto& plane : m_Planes)
+	{
+		// Corner farthest along the normal, if it is outside the whole box is
+		glm::vec3 corner(
+			plane.x >= 0.0f ? box.max.x : box.min.x,
+			plane.y >= 0.0f ? box.max.y : box.min.y,
+			plane.z >= 0.0f ? box.max.z : box.min.z);
+
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
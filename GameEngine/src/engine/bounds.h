@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <algorithm>
+
+#include <GLM/glm.hpp>
+
+#include "mat4.h"
+
+// Axis aligned box, empty until a point is added
+struct BoundingBox
+{
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+	void expand(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+	void expand(const BoundingBox& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+
+	bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+};
+
+struct BoundingSphere
+{
+	glm::vec3 center{ 0.0f };
+	float radius = -1.0f;
+
+	bool empty() const { return radius < 0.0f; }
+
+	// Grows the radius so the sphere also encloses s, the center stays in place
+	void enclose(const BoundingSphere& s)
+	{
+		if (!s.empty())
+			radius = std::max(radius, glm::length(s.center - center) + s.radius);
+	}
+};
+
+// Planes of the view volume of a model view projection matrix, in the space
+// the matrix is applied to (object space for an mvp), normals point inside
+class Frustum
+{
+public:
+	// glm matrices are column major
+	explicit Frustum(const glm::mat4& m);
+	// cgl matrices are row major
+	explicit Frustum(const cgl::mat4& m);
+
+	// Conservative, a volume near a corner of the frustum may be kept
+	bool Intersects(const BoundingSphere& sphere) const;
+	bool Intersects(const BoundingBox& box) const;
+
+	// Sphere first as it is cheaper, the box is tighter
+	bool Intersects(const BoundingSphere& sphere, const BoundingBox& box) const { return Intersects(sphere) && Intersects(box); }
+
+private:
+	// ax + by + cz + d >= 0 inside, (a, b, c) normalized
+	std::array<glm::vec4, 6> m_Planes;
+
+	void setPlanes(const glm::vec4 rows[4]);
+};
@@ -115,6 +115,7 @@ namespace cgl
 
         void OnImGui() override
         {
+#ifndef CLOSE2GL_HEADLESS
             if (ImGui::TreeNode("Camera Config"))
             {
                 if (ImGui::Button("Reset"))
@@ -128,6 +129,7 @@ namespace cgl
                 ImGui::DragFloat("Movement Speed:", &MovementSpeed, 0.1f, -1000.0f, 1000.0f);
                 ImGui::TreePop();
             }
+#endif
         }
 
         void Reset() override
@@ -383,6 +385,7 @@ namespace ogl
 
         void OnImGui() override
         {
+#ifndef CLOSE2GL_HEADLESS
             if (ImGui::TreeNode("Camera Config"))
             {
                 if (ImGui::Button("Reset"))
@@ -396,6 +399,7 @@ namespace ogl
                 ImGui::DragFloat("Movement Speed:", &MovementSpeed, 0.1f, -1000.0f, 1000.0f);
                 ImGui::TreePop();
             }
+#endif
         }
 
         void Reset() override
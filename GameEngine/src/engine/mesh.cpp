@@ -3,7 +3,11 @@
 Mesh::Mesh(const std::vector<Vertex>& vert, const std::vector<unsigned int>& indi, const std::vector<std::shared_ptr<Texture>>& text)
 	: vertices(vert), indices(indi), textures(text)
 {
+#ifndef CLOSE2GL_HEADLESS
 	this->setupBuffers();
+#endif
+	this->setupStreams();
+	this->setupBounds();
 }
 
 void Mesh::SetupMesh(const std::vector<Vertex>& vert, const std::vector<unsigned int>& indi, const std::vector<std::shared_ptr<Texture>>& text)
@@ -11,9 +15,14 @@ void Mesh::SetupMesh(const std::vector<Vertex>& vert, const std::vector<unsigned
 	vertices = vert;
 	indices = indi;
 	textures = text;
+#ifndef CLOSE2GL_HEADLESS
 	this->setupBuffers();
+#endif
+	this->setupStreams();
+	this->setupBounds();
 }
 
+#ifndef CLOSE2GL_HEADLESS
 void Mesh::setupBuffers()
 {
 	VAO = std::make_shared<VertexArray>();
@@ -32,8 +41,38 @@ void Mesh::setupBuffers()
 
 	VAO->Unbind();
 }
+#endif
 
+void Mesh::setupStreams()
+{
+	positions.resize(vertices.size());
+	normals.resize(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		positions.set(i, vertices[i].Position);
+		normals.set(i, vertices[i].Normal);
+	}
+}
+
+void Mesh::setupBounds()
+{
+	bounds = BoundingBox();
+	for (const auto& vertex : vertices)
+		bounds.expand(vertex.Position);
+
+	sphere = BoundingSphere();
+	if (bounds.empty())
+		return;
+
+	// Centered on the box, usually tighter than its half diagonal
+	sphere.center = bounds.center();
+	sphere.radius = 0.0f;
+	for (const auto& vertex : vertices)
+		sphere.radius = std::max(sphere.radius, glm::length(vertex.Position - sphere.center));
+}
 
+#ifndef CLOSE2GL_HEADLESS
 void Mesh::Draw(Shader& shader, PRIMITIVE drawPrimitive) const
 {
 	for (int i = 0; i < textures.size(); ++i)
@@ -51,5 +90,6 @@ void Mesh::Draw(Shader& shader, PRIMITIVE drawPrimitive) const
 
 	glActiveTexture(GL_TEXTURE0);
 }
+#endif
 
 
@@ -13,6 +13,11 @@
 #include "VertexBufferLayout.h"
 #include "Texture.h"
 
+// Math
+#include "vec_soa.h"
+
+#include "bounds.h"
+
 enum class TriangleOrientation
 {
 	ClockWise = 0,
@@ -48,6 +53,14 @@ public:
 	std::vector<unsigned int> indices;
 	std::vector<std::shared_ptr<Texture>> textures;
 
+	// Positions and normals of the vertices split by component for the Close2GL vertex stage
+	cgl::vec3_soa positions;
+	cgl::vec3_soa normals;
+
+	// Object space bounds, computed once when the mesh is set up
+	BoundingBox bounds;
+	BoundingSphere sphere;
+
 	Mesh() = default;
 	Mesh(const std::vector<Vertex>& vert, const std::vector<unsigned int>& indi, const std::vector<std::shared_ptr<Texture>>& text);
 	void Draw(Shader& shader, PRIMITIVE drawPrimitive = PRIMITIVE::Triangle) const;
@@ -59,5 +72,7 @@ private:
 	std::shared_ptr<IndexBuffer>  EBO;
 	VertexBufferLayout VBL;
 	void setupBuffers();
+	void setupStreams();
+	void setupBounds();
 };
 
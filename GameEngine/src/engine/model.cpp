@@ -5,7 +5,8 @@ static glm::vec3 _random_normalized_color()
 	return { rand() / (RAND_MAX + 1.0), rand() / (RAND_MAX + 1.0), rand() / (RAND_MAX + 1.0) };
 }
 
-void Model::Draw(Shader& shader, PRIMITIVE drawPrimitive) const
+#ifndef CLOSE2GL_HEADLESS
+void Model::Draw(Shader& shader, PRIMITIVE drawPrimitive, const glm::mat4* viewProjection) const
 {
 	glm::mat4 model = glm::mat4(1.0f);
 	model = glm::translate(model, transform.position);
@@ -15,11 +16,25 @@ void Model::Draw(Shader& shader, PRIMITIVE drawPrimitive) const
 	model = glm::scale(model, transform.scale);
 	shader.SetUniformMatrix4fv("model", model);
 
+	if (!viewProjection)
+	{
+		for (unsigned int i = 0; i < meshes.size(); ++i)
+			meshes[i].Draw(shader, drawPrimitive);
+		return;
+	}
+
+	// Planes in object space, so the cached bounds are tested as they are
+	Frustum frustum(*viewProjection * model);
+	if (!frustum.Intersects(sphere, bounds))
+		return;
+
 	for (unsigned int i = 0; i < meshes.size(); ++i)
 	{
-		meshes[i].Draw(shader, drawPrimitive);
+		if (frustum.Intersects(meshes[i].sphere, meshes[i].bounds))
+			meshes[i].Draw(shader, drawPrimitive);
 	}
 }
+#endif
 
 cgl::mat4 Model::GetModelMatrix() const
 {
@@ -32,6 +47,23 @@ cgl::mat4 Model::GetModelMatrix() const
 	return model;
 }
 
+void Model::computeBounds()
+{
+	bounds = BoundingBox();
+	for (const auto& mesh : meshes)
+		bounds.expand(mesh.bounds);
+
+	sphere = BoundingSphere();
+	if (bounds.empty())
+		return;
+
+	sphere.center = bounds.center();
+	sphere.radius = 0.0f;
+	for (const auto& mesh : meshes)
+		sphere.enclose(mesh.sphere);
+}
+
+#ifndef CLOSE2GL_HEADLESS
 void Model::OnImGui() const
 {
 	if (ImGui::TreeNode(std::string("Transform " + name).c_str()))
@@ -42,6 +74,7 @@ void Model::OnImGui() const
 		ImGui::TreePop();
 	}
 }
+#endif
 
 void Model::LoadCustomModel(TriangleOrientation triOrientation)
 {
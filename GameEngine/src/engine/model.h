@@ -15,6 +15,7 @@
 #include "vec4.h"
 #include "mat.hpp"
 #include "ViewPort.hpp"
+#include "Profiler.hpp"
 
 struct Model
 {
@@ -22,14 +23,20 @@ public:
 	Model(const std::string& path, TriangleOrientation triOrientation = TriangleOrientation::CounterClockWise)
 		:m_Path(path)
 	{
+		PROFILE_SCOPE("Model Load");
+
 		if (m_Path.substr(m_Path.find_last_of('.') + 1) == "in")
 			LoadCustomModel(triOrientation);
 		else
 			LoadClassicModel();
+
+		computeBounds();
 	}
 
+	// With a view projection matrix, meshes outside of its frustum are skipped
 	void Draw(Shader& shader, 
-		PRIMITIVE drawPrimitive = PRIMITIVE::Triangle) const;
+		PRIMITIVE drawPrimitive = PRIMITIVE::Triangle,
+		const glm::mat4* viewProjection = nullptr) const;
 	
 	cgl::mat4 GetModelMatrix() const;
 	void OnImGui() const;
@@ -38,12 +45,17 @@ public:
 	std::vector<std::shared_ptr<Texture>> textures_loaded;
 	Transform transform;
 
+	// Object space bounds of all the meshes, computed at load time
+	BoundingBox bounds;
+	BoundingSphere sphere;
+
 private:
 	std::string m_Path;
 	inline static std::unordered_map<std::string, int> m_NamesMap;
 
 	void LoadClassicModel();
 	void LoadCustomModel(TriangleOrientation triOrientation);
+	void computeBounds();
 
 	void processNode(aiNode* node, const aiScene* scene);
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
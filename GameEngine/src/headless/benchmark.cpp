@@ -0,0 +1,329 @@
+// Renders a fixed matrix of scenes with the Close2GL rasterizer, without a
+// window or a GL context, and writes the throughput of every configuration
+// as JSON so runs of different versions can be compared
+//
+// Close2GLBenchmark [options], run from the GameEngine directory
+//   --output <file>      close2gl_benchmark.json
+//   --frames <n>         frames measured per configuration, 30
+//   --warmup <n>         frames rendered before measuring, 3
+//   --models <list>      comma separated subset of cube,cow,teapot,backpack,bunny,dragon,sponza
+//   --resolutions <list> comma separated subset of 720p,1080p,4k
+//   --tiled <threads>    tiled rendering, 0 uses every hardware thread
+//
+// Models that cannot be loaded are listed as skipped in the JSON and the exit
+// code is 2, so an incomplete run is not mistaken for a full one
+
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Dependencies
+#define STB_IMAGE_IMPLEMENTATION
+#include <STB/stb_image.h>              // STB (Image Loader)
+
+// Engine
+#include "model.h"
+#include "rasterizer/rasterizer.hpp"
+#include "common.hpp"
+
+namespace
+{
+	struct BenchmarkModel
+	{
+		const char* name;
+		const char* path;
+	};
+
+	const BenchmarkModel MODELS[] = {
+		{ "cube",     "resources/models/cube_text.in" },
+		{ "cow",      "resources/models/cow_up_no_text.in" },
+		{ "teapot",   "resources/models/teapot.obj" },
+		{ "backpack", "resources/models/backpack/backpack.obj" },
+		{ "bunny",    "resources/models/bunny.obj" },
+		{ "dragon",   "resources/models/dragon.obj" },
+		{ "sponza",   "resources/models/sponza/sponza.obj" },
+	};
+
+	struct Resolution
+	{
+		const char* name;
+		unsigned int width;
+		unsigned int height;
+	};
+
+	const Resolution RESOLUTIONS[] = {
+		{ "720p",  1280,  720 },
+		{ "1080p", 1920, 1080 },
+		{ "4k",    3840, 2160 },
+	};
+
+	const std::pair<const char*, SHADING> SHADINGS[] = {
+		{ "none",    SHADING::NONE },
+		{ "gouraud", SHADING::GOURAUD },
+		{ "phong",   SHADING::PHONG },
+	};
+
+	const std::pair<const char*, Texture::Filtering> FILTERS[] = {
+		{ "nearest",   Texture::Filtering::NEAREST_NEIGHBOR },
+		{ "bilinear",  Texture::Filtering::BILINEAR },
+		{ "bicubic",   Texture::Filtering::BICUBIC },
+		{ "trilinear", Texture::Filtering::TRILLINEAR },
+	};
+
+	struct Options
+	{
+		std::string outputPath = "close2gl_benchmark.json";
+		unsigned int frames = 30;
+		unsigned int warmup = 3;
+		std::vector<std::string> models;
+		std::vector<std::string> resolutions;
+		bool isTiled = false;
+		unsigned int threadCount = 1;
+	};
+
+	struct Result
+	{
+		std::string model;
+		std::string resolution;
+		std::string shading;
+		std::string filtering;
+		uint64_t triangles = 0;
+		uint64_t fragments = 0;
+		double meanMs = 0.0;
+		double p50Ms = 0.0;
+		double p99Ms = 0.0;
+		double trianglesPerSecond = 0.0;
+		double fragmentsPerSecond = 0.0;
+		size_t arenaBytes = 0;
+	};
+
+	std::vector<std::string> Split(const std::string& list)
+	{
+		std::vector<std::string> items;
+		std::istringstream in(list);
+		std::string item;
+		while (std::getline(in, item, ','))
+		{
+			if (!item.empty())
+				items.push_back(item);
+		}
+		return items;
+	}
+
+	bool IsSelected(const std::vector<std::string>& selection, const char* name)
+	{
+		return selection.empty() || std::find(selection.begin(), selection.end(), name) != selection.end();
+	}
+
+	bool ParseArguments(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			if (i + 1 >= argc)
+			{
+				std::cerr << "Missing value of " << arg << "\n";
+				return false;
+			}
+			const std::string value = argv[++i];
+
+			if (arg == "--output")
+				options.outputPath = value;
+			else if (arg == "--frames")
+				options.frames = std::max(1u, (unsigned int)std::stoul(value));
+			else if (arg == "--warmup")
+				options.warmup = (unsigned int)std::stoul(value);
+			else if (arg == "--models")
+				options.models = Split(value);
+			else if (arg == "--resolutions")
+				options.resolutions = Split(value);
+			else if (arg == "--tiled")
+			{
+				const unsigned int threads = (unsigned int)std::stoul(value);
+				options.isTiled = true;
+				options.threadCount = threads ? threads : Rasterizer::GetMaxThreadCount();
+			}
+			else
+			{
+				std::cerr << "Unknown argument: " << arg << "\n";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Nearest rank, times are sorted
+	double Percentile(const std::vector<double>& times, double p)
+	{
+		size_t rank = (size_t)std::ceil(p * (double)times.size());
+		return times[std::clamp<size_t>(rank, 1, times.size()) - 1];
+	}
+
+	Result Measure(const Options& options, RasterizerFrame& frame)
+	{
+		for (unsigned int i = 0; i < options.warmup; ++i)
+		{
+			Rasterizer::SubmitFrame(frame);
+			Rasterizer::TakeFrame();
+		}
+
+		Result result;
+		std::vector<double> times;
+		times.reserve(options.frames);
+
+		for (unsigned int i = 0; i < options.frames; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			Rasterizer::SubmitFrame(frame);
+			Rasterizer::TakeFrame();
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			// Every frame draws the same thing
+			result.triangles = Rasterizer::GetPipelineStatistics().trianglesRasterized;
+			result.fragments = Rasterizer::GetPipelineStatistics().fragmentsGenerated;
+		}
+
+		double total = 0.0;
+		for (double t : times)
+			total += t;
+
+		std::sort(times.begin(), times.end());
+		result.meanMs = total / times.size();
+		result.p50Ms = Percentile(times, 0.50);
+		result.p99Ms = Percentile(times, 0.99);
+		result.trianglesPerSecond = (double)result.triangles / (result.meanMs / 1000.0);
+		result.fragmentsPerSecond = (double)result.fragments / (result.meanMs / 1000.0);
+		result.arenaBytes = Rasterizer::GetArenaUsage();
+		return result;
+	}
+
+	void WriteJSON(std::ostream& out, const Options& options, const std::vector<Result>& results, const std::vector<std::string>& skipped)
+	{
+		out << "{\n";
+		out << "  \"frames\": " << options.frames << ",\n";
+		out << "  \"warmup\": " << options.warmup << ",\n";
+		out << "  \"tiled\": " << (options.isTiled ? "true" : "false") << ",\n";
+		out << "  \"threads\": " << options.threadCount << ",\n";
+		// High-water mark of the whole process, it never goes down so it is only meaningful per run
+		out << "  \"peak_memory_bytes\": " << PeakMemory() << ",\n";
+
+		out << "  \"skipped\": [";
+		for (size_t i = 0; i < skipped.size(); ++i)
+			out << (i ? ", " : "") << '"' << skipped[i] << '"';
+		out << "],\n";
+
+		out << "  \"results\": [\n";
+
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const Result& r = results[i];
+			out << "    { "
+				<< "\"model\": \"" << r.model << "\", "
+				<< "\"resolution\": \"" << r.resolution << "\", "
+				<< "\"shading\": \"" << r.shading << "\", "
+				<< "\"filtering\": \"" << r.filtering << "\", "
+				<< "\"triangles\": " << r.triangles << ", "
+				<< "\"fragments\": " << r.fragments << ", "
+				<< "\"ms_mean\": " << r.meanMs << ", "
+				<< "\"ms_p50\": " << r.p50Ms << ", "
+				<< "\"ms_p99\": " << r.p99Ms << ", "
+				<< "\"triangles_per_second\": " << r.trianglesPerSecond << ", "
+				<< "\"fragments_per_second\": " << r.fragmentsPerSecond << ", "
+				<< "\"arena_bytes\": " << r.arenaBytes
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+
+		out << "  ]\n";
+		out << "}\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseArguments(argc, argv, options))
+	{
+		std::cerr << "Usage: Close2GLBenchmark [--output file.json] [--frames n] [--warmup n] [--models list] [--resolutions list] [--tiled threads]\n";
+		return 1;
+	}
+
+	std::vector<Result> results;
+	std::vector<std::string> skipped;
+
+	for (const auto& benchmarkModel : MODELS)
+	{
+		if (!IsSelected(options.models, benchmarkModel.name))
+			continue;
+
+		// One model in memory at a time, Sponza alone is large
+		auto model = std::make_unique<Model>(benchmarkModel.path);
+		if (model->meshes.empty())
+		{
+			std::cerr << "Skipping " << benchmarkModel.name << ", nothing was loaded from " << benchmarkModel.path << "\n";
+			skipped.push_back(benchmarkModel.name);
+			continue;
+		}
+
+		for (const auto& resolution : RESOLUTIONS)
+		{
+			if (!IsSelected(options.resolutions, resolution.name))
+				continue;
+
+			RasterizerFrame frame;
+			frame.width = resolution.width;
+			frame.height = resolution.height;
+			frame.isTiled = options.isTiled;
+			frame.threadCount = options.threadCount;
+			frame.showTextures = true;
+			frame.draws = { { model.get(), model->transform } };
+
+			FrameBounds(model->bounds, (float)resolution.width / (float)resolution.height, frame.camera);
+			frame.light = DirectionalLight({ 1.0f, 1.0f, 1.0f }, { frame.camera.Front.x, frame.camera.Front.y, frame.camera.Front.z });
+
+			for (const auto& [shadingName, shading] : SHADINGS)
+			{
+				for (const auto& [filterName, filtering] : FILTERS)
+				{
+					frame.shading = shading;
+					frame.filtering = filtering;
+
+					Result result = Measure(options, frame);
+					result.model = benchmarkModel.name;
+					result.resolution = resolution.name;
+					result.shading = shadingName;
+					result.filtering = filterName;
+
+					std::cout << result.model << ' ' << result.resolution << ' ' << result.shading << ' ' << result.filtering
+						<< ": " << result.meanMs << " ms mean, " << result.p99Ms << " ms p99, "
+						<< result.fragmentsPerSecond / 1e6 << " Mfragments/s\n";
+
+					results.push_back(std::move(result));
+				}
+			}
+		}
+	}
+
+	std::ofstream file(options.outputPath);
+	if (!file)
+	{
+		std::cerr << "Could not write " << options.outputPath << "\n";
+		return 1;
+	}
+	WriteJSON(file, options, results, skipped);
+	std::cout << "Wrote " << results.size() << " results to " << options.outputPath << "\n";
+
+	if (!skipped.empty())
+	{
+		std::cerr << skipped.size() << " models were skipped\n";
+		return 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,41 @@
+#include "common.hpp"
+
+#include <GLM/glm.hpp>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+void FrameBounds(const BoundingBox& aabb, float aspectRatio, cgl::Camera& camera)
+{
+	camera.Reset();
+	float OPP = (aabb.max.y + aabb.min.y) / 2;
+	float OPPX = (aabb.max.x + aabb.min.x) / 2;
+	camera.Position.x = OPPX;
+	camera.Position.y = OPP;
+	float TAN = glm::tan(glm::radians(camera.Zoom / 2));
+	float yBig = (aabb.max.z + ((aabb.max.y - OPP) / TAN));
+	float xBig = (aabb.max.z + ((aabb.max.x - OPPX) / glm::tan(glm::radians((camera.Zoom * aspectRatio) / 2))));
+	camera.Position.z = (xBig > yBig) ? xBig : yBig;
+	camera.updateCameraVectors();
+}
+
+size_t PeakMemory()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return (size_t)usage.ru_maxrss * 1024;
+	return 0;
+#endif
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+#include "camera.h"
+#include "bounds.h"
+
+// Places the camera in front of the bounds so they fill the view, the same
+// framing the scene uses when an object is added
+void FrameBounds(const BoundingBox& aabb, float aspectRatio, cgl::Camera& camera);
+
+// Largest resident memory of the process so far, in bytes, 0 when unknown
+size_t PeakMemory();
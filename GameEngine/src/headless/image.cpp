@@ -0,0 +1,149 @@
+#include "image.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+	// Rows of RGB bytes top to bottom, the frame buffer rows are bottom up
+	std::vector<unsigned char> RowsRGB(const FrameBuffer& frame, bool filterBytes)
+	{
+		const size_t width = frame.width();
+		const size_t height = frame.height();
+
+		std::vector<unsigned char> rows;
+		rows.reserve(height * (width * 3 + (filterBytes ? 1 : 0)));
+
+		for (size_t y = 0; y < height; ++y)
+		{
+			// No filter
+			if (filterBytes)
+				rows.push_back(0);
+
+			for (size_t x = 0; x < width; ++x)
+			{
+				Pixel p = frame.get((unsigned int)y, (unsigned int)x);
+				rows.push_back(p.r);
+				rows.push_back(p.g);
+				rows.push_back(p.b);
+			}
+		}
+		return rows;
+	}
+
+	uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::array<uint32_t, 256> table = []
+		{
+			std::array<uint32_t, 256> t{};
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+			return t;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t Adler32(const std::vector<unsigned char>& data)
+	{
+		uint32_t a = 1, b = 0;
+		for (unsigned char byte : data)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void PushBigEndian(std::vector<unsigned char>& out, uint32_t v)
+	{
+		out.push_back((unsigned char)(v >> 24));
+		out.push_back((unsigned char)(v >> 16));
+		out.push_back((unsigned char)(v >> 8));
+		out.push_back((unsigned char)v);
+	}
+
+	void WriteChunk(std::ofstream& file, const char type[4], const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		PushBigEndian(chunk, (uint32_t)data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		// Over the type and the data
+		PushBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+
+		file.write((const char*)chunk.data(), (std::streamsize)chunk.size());
+	}
+}
+
+bool WritePPM(const std::string& path, const FrameBuffer& frame)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	file << "P6\n" << frame.width() << ' ' << frame.height() << "\n255\n";
+
+	std::vector<unsigned char> rows = RowsRGB(frame, false);
+	file.write((const char*)rows.data(), (std::streamsize)rows.size());
+	return (bool)file;
+}
+
+bool WritePNG(const std::string& path, const FrameBuffer& frame)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, 8);
+
+	std::vector<unsigned char> header;
+	PushBigEndian(header, (uint32_t)frame.width());
+	PushBigEndian(header, (uint32_t)frame.height());
+	// 8 bits, RGB, deflate, adaptive filtering, no interlace
+	header.insert(header.end(), { 8, 2, 0, 0, 0 });
+	WriteChunk(file, "IHDR", header);
+
+	// zlib stream made of stored deflate blocks of at most 65535 bytes
+	std::vector<unsigned char> rows = RowsRGB(frame, true);
+	std::vector<unsigned char> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < rows.size() || offset == 0; )
+	{
+		const size_t size = std::min<size_t>(rows.size() - offset, 65535);
+		const bool isLast = offset + size == rows.size();
+
+		zlib.push_back(isLast ? 1 : 0);
+		zlib.push_back((unsigned char)size);
+		zlib.push_back((unsigned char)(size >> 8));
+		zlib.push_back((unsigned char)~size);
+		zlib.push_back((unsigned char)(~size >> 8));
+		zlib.insert(zlib.end(), rows.begin() + offset, rows.begin() + offset + size);
+
+		offset += size;
+		if (isLast)
+			break;
+	}
+	PushBigEndian(zlib, Adler32(rows));
+	WriteChunk(file, "IDAT", zlib);
+
+	WriteChunk(file, "IEND", {});
+	return (bool)file;
+}
+
+bool WriteImage(const std::string& path, const FrameBuffer& frame)
+{
+	const bool isPNG = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+	return isPNG ? WritePNG(path, frame) : WritePPM(path, frame);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+#include "rasterizer/framebuffer.hpp"
+
+// Writes the frame as binary PPM (P6), top row first
+bool WritePPM(const std::string& path, const FrameBuffer& frame);
+
+// Writes the frame as an 8 bits RGB PNG. The image data is stored without
+// compression, so no zlib is needed, only the checksums PNG requires
+bool WritePNG(const std::string& path, const FrameBuffer& frame);
+
+// Picks the format from the extension of the path, PPM unless it ends in .png
+bool WriteImage(const std::string& path, const FrameBuffer& frame);
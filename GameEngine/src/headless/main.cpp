@@ -0,0 +1,330 @@
+// Renders a model with the Close2GL rasterizer without a window or a GL
+// context, writes the last frame to an image and reports frame timings
+//
+// Close2GLHeadless <model> [options]
+//   --camera <file>     position x y z, yaw, pitch, fov, near, far, lookat x y z, one per line
+//   --width <n>         640
+//   --height <n>        480
+//   --frames <n>        1
+//   --output <file>     close2gl.ppm, .png writes a PNG
+//   --shading <s>       none | gouraud | phong
+//   --primitive <p>     triangle | wireframe | point
+//   --traversal <t>     scanline | halfspace | subpixel
+//   --filter <f>        nearest | bilinear | bicubic | trilinear
+//   --depth <d>         float32 | reversed | unorm24 | unorm16
+//   --tiled <threads>   tiled rendering, 0 uses every hardware thread
+//   --tile-size <n>     64
+//   --textures          samples the diffuse textures
+//   --cull              back face culling
+//   --clockwise         loads and culls clockwise triangles
+//   --deferred          deferred shading
+//   --no-hiz            disables the hierarchical z buffer
+//   --spin <degrees>    rotates the model around y by that much every frame
+//   --heatmap <h>       overdraw | tiles, draws the capture of the frame instead of it
+//   --capture <prefix>  writes the overdraw and tile costs of the last frame to prefix_*.raw
+//   --trace <file>      writes the profiler zones of every frame as a Chrome trace
+
+// STL
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Dependencies
+#define STB_IMAGE_IMPLEMENTATION
+#include <STB/stb_image.h>              // STB (Image Loader)
+#include <GLM/glm.hpp>                  // GLM (Math Library)
+
+// Engine
+#include "camera.h"
+#include "light.h"
+#include "model.h"
+#include "rasterizer/rasterizer.hpp"
+#include "image.hpp"
+#include "common.hpp"
+
+namespace
+{
+	struct Options
+	{
+		std::string modelPath;
+		std::string cameraPath;
+		std::string outputPath = "close2gl.ppm";
+		std::string capturePath;
+		std::string tracePath;
+		unsigned int width = 640;
+		unsigned int height = 480;
+		unsigned int frames = 1;
+		float spin = 0.0f;
+		bool isClockWise = false;
+		RasterizerFrame frame;
+	};
+
+	int Usage()
+	{
+		std::cerr << "Usage: Close2GLHeadless <model> [--camera file] [--width n] [--height n] [--frames n] [--output file.ppm|file.png]\n"
+			"       [--shading none|gouraud|phong] [--primitive triangle|wireframe|point] [--traversal scanline|halfspace|subpixel]\n"
+			"       [--filter nearest|bilinear|bicubic|trilinear] [--depth float32|reversed|unorm24|unorm16] [--tiled threads] [--tile-size n]\n"
+			"       [--textures] [--cull] [--clockwise] [--deferred] [--no-hiz] [--spin degrees]\n"
+			"       [--heatmap overdraw|tiles] [--capture prefix] [--trace file.json]\n";
+		return 1;
+	}
+
+	template <typename T>
+	bool Pick(const std::string& value, std::initializer_list<std::pair<const char*, T>> choices, T& out)
+	{
+		for (const auto& [name, choice] : choices)
+		{
+			if (value == name)
+			{
+				out = choice;
+				return true;
+			}
+		}
+		std::cerr << "Unknown value: " << value << "\n";
+		return false;
+	}
+
+	bool ParseArguments(int argc, char** argv, Options& options)
+	{
+		RasterizerFrame& frame = options.frame;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			auto value = [&]() { return std::string(argv[++i]); };
+
+			if (arg == "--textures")
+				frame.showTextures = true;
+			else if (arg == "--cull")
+				frame.isCulling = true;
+			else if (arg == "--clockwise")
+				options.isClockWise = frame.isCullingClockWise = true;
+			else if (arg == "--deferred")
+				frame.isDeferred = true;
+			else if (arg == "--no-hiz")
+				frame.isHiZ = false;
+			else if (arg.rfind("--", 0) == 0 && !hasValue)
+			{
+				std::cerr << "Missing value of " << arg << "\n";
+				return false;
+			}
+			else if (arg == "--camera")
+				options.cameraPath = value();
+			else if (arg == "--output")
+				options.outputPath = value();
+			else if (arg == "--width")
+				options.width = (unsigned int)std::stoul(value());
+			else if (arg == "--height")
+				options.height = (unsigned int)std::stoul(value());
+			else if (arg == "--frames")
+				options.frames = std::max(1u, (unsigned int)std::stoul(value()));
+			else if (arg == "--spin")
+				options.spin = std::stof(value());
+			else if (arg == "--capture")
+				options.capturePath = value();
+			else if (arg == "--trace")
+				options.tracePath = value();
+			else if (arg == "--heatmap")
+			{
+				if (!Pick(value(), { { "overdraw", HEATMAP::OVERDRAW }, { "tiles", HEATMAP::TILE_COST } }, frame.heatmap))
+					return false;
+			}
+			else if (arg == "--tile-size")
+				frame.tileSize = (unsigned int)std::stoul(value());
+			else if (arg == "--tiled")
+			{
+				const unsigned int threads = (unsigned int)std::stoul(value());
+				frame.isTiled = true;
+				frame.threadCount = threads ? threads : Rasterizer::GetMaxThreadCount();
+			}
+			else if (arg == "--shading")
+			{
+				if (!Pick(value(), { { "none", SHADING::NONE }, { "gouraud", SHADING::GOURAUD }, { "phong", SHADING::PHONG } }, frame.shading))
+					return false;
+			}
+			else if (arg == "--primitive")
+			{
+				if (!Pick(value(), { { "triangle", PRIMITIVE::Triangle }, { "wireframe", PRIMITIVE::WireFrame }, { "point", PRIMITIVE::Point } }, frame.primitive))
+					return false;
+			}
+			else if (arg == "--traversal")
+			{
+				if (!Pick(value(), { { "scanline", TRAVERSAL::SCANLINE }, { "halfspace", TRAVERSAL::HALF_SPACE }, { "subpixel", TRAVERSAL::HALF_SPACE_SUBPIXEL } }, frame.traversal))
+					return false;
+			}
+			else if (arg == "--filter")
+			{
+				if (!Pick(value(), { { "nearest", Texture::Filtering::NEAREST_NEIGHBOR }, { "bilinear", Texture::Filtering::BILINEAR }, { "bicubic", Texture::Filtering::BICUBIC }, { "trilinear", Texture::Filtering::TRILLINEAR } }, frame.filtering))
+					return false;
+			}
+			else if (arg == "--depth")
+			{
+				if (!Pick(value(), { { "float32", DEPTH_FORMAT::FLOAT32 }, { "reversed", DEPTH_FORMAT::FLOAT32_REVERSED }, { "unorm24", DEPTH_FORMAT::UNORM24 }, { "unorm16", DEPTH_FORMAT::UNORM16 } }, frame.depthFormat))
+					return false;
+			}
+			else if (arg.rfind("--", 0) != 0 && options.modelPath.empty())
+				options.modelPath = arg;
+			else
+			{
+				std::cerr << "Unknown argument: " << arg << "\n";
+				return false;
+			}
+		}
+
+		return !options.modelPath.empty() && options.width > 0 && options.height > 0;
+	}
+
+	bool LoadCamera(const std::string& path, cgl::Camera& camera)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			std::cerr << "Could not open the camera file " << path << "\n";
+			return false;
+		}
+
+		bool isLookAt = false;
+		cgl::vec3 lookAt;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream in(line);
+			std::string key;
+			if (!(in >> key) || key[0] == '#')
+				continue;
+
+			if (key == "position")
+				in >> camera.Position.x >> camera.Position.y >> camera.Position.z;
+			else if (key == "yaw")
+				in >> camera.Yaw;
+			else if (key == "pitch")
+				in >> camera.Pitch;
+			else if (key == "fov")
+				in >> camera.Zoom;
+			else if (key == "near")
+				in >> camera.Near;
+			else if (key == "far")
+				in >> camera.Far;
+			else if (key == "lookat")
+			{
+				in >> lookAt.x >> lookAt.y >> lookAt.z;
+				isLookAt = true;
+			}
+			else
+			{
+				std::cerr << "Unknown camera key: " << key << "\n";
+				return false;
+			}
+
+			if (in.fail())
+			{
+				std::cerr << "Bad camera line: " << line << "\n";
+				return false;
+			}
+		}
+
+		camera.updateCameraVectors();
+		// After the position is known, it is relative to it
+		if (isLookAt)
+			camera.SetLookAt(lookAt);
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseArguments(argc, argv, options))
+		return Usage();
+
+	RasterizerFrame& frame = options.frame;
+	frame.width = options.width;
+	frame.height = options.height;
+	frame.light = DirectionalLight({ 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, -1.0f });
+
+	auto loadStart = std::chrono::steady_clock::now();
+	Model model(options.modelPath, options.isClockWise ? TriangleOrientation::ClockWise : TriangleOrientation::CounterClockWise);
+	double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+
+	if (model.meshes.empty())
+	{
+		std::cerr << "Nothing was loaded from " << options.modelPath << "\n";
+		return 1;
+	}
+
+	if (!options.cameraPath.empty())
+	{
+		if (!LoadCamera(options.cameraPath, frame.camera))
+			return 1;
+	}
+	else
+	{
+		FrameBounds(model.bounds, (float)options.width / (float)options.height, frame.camera);
+	}
+	// Lit from the eye like the scene does
+	frame.light.direction = glm::vec3(frame.camera.Front.x, frame.camera.Front.y, frame.camera.Front.z);
+
+	std::cout << "Loaded " << options.modelPath << " in " << loadTime << " ms\n";
+	std::cout << "frame,total_ms,texturing_ms,heap_allocations,arena_bytes\n";
+
+	std::vector<double> frameTimes;
+	frameTimes.reserve(options.frames);
+
+	Transform transform = model.transform;
+	const FrameBuffer* result = nullptr;
+	for (unsigned int i = 0; i < options.frames; ++i)
+	{
+		PROFILE_FRAME();
+
+		transform.rotation.y = model.transform.rotation.y + options.spin * (float)i;
+		frame.draws = { { &model, transform } };
+		if (i + 1 == options.frames)
+			frame.capturePath = options.capturePath;
+
+		// Synchronous, the frame is ready as soon as it is submitted
+		auto start = std::chrono::steady_clock::now();
+		Rasterizer::SubmitFrame(frame);
+		result = Rasterizer::TakeFrame();
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		frameTimes.push_back(elapsed);
+		std::cout << i << ',' << elapsed << ',' << Rasterizer::GetTexturingTime() * 1000 << ','
+			<< Rasterizer::GetHeapAllocations() << ',' << Rasterizer::GetArenaUsage() << "\n";
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+	double total = 0.0;
+	for (double t : frameTimes)
+		total += t;
+
+	std::cout << "frames " << frameTimes.size()
+		<< ", mean " << total / frameTimes.size() << " ms"
+		<< ", min " << frameTimes.front() << " ms"
+		<< ", median " << frameTimes[frameTimes.size() / 2] << " ms"
+		<< ", max " << frameTimes.back() << " ms\n";
+
+	if (!result || !WriteImage(options.outputPath, *result))
+	{
+		std::cerr << "Could not write " << options.outputPath << "\n";
+		return 1;
+	}
+	std::cout << "Wrote " << options.outputPath << "\n";
+
+	if (!options.tracePath.empty())
+	{
+		if (!Profiler::ExportChromeTrace(options.tracePath, options.frames))
+		{
+			std::cerr << "Could not write " << options.tracePath << "\n";
+			return 1;
+		}
+		std::cout << "Wrote " << options.tracePath << "\n";
+	}
+
+	return 0;
+}
@@ -35,6 +35,8 @@
 // #include "engine/mesh.h"
 #include "model.h"
 #include "Timer.hpp"
+#include "Profiler.hpp"
+#include "FrameTimes.hpp"
 #include "ViewPort.hpp"
 
 // Scenes
@@ -101,10 +103,19 @@ int main()
     double deltaTime = 0.0f;
     double lastFrame = 0.0f;
 
+    Profiler::SetThreadName("Main");
+    int traceFrames = 60;
+
+    FrameTimes frameTimes;
+    uint64_t presentedFrame = Rasterizer::GetPresentedFrame();
+
     try
     {
         while (!glfwWindowShouldClose(pWindow))
         {
+            PROFILE_FRAME();
+            Timer frameTimer;
+
             processInputs(pWindow, deltaTime);
 
             pViewport->Bind();
@@ -132,6 +143,18 @@ int main()
 
                 ImGui::Separator();
                 ImGui::TextColored(ImVec4(0.51f, 0.82f, 0.345f, 1.0f), "FPS: %.2f\nTake %.2f ms", 1 / deltaTime, deltaTime * 1000);
+                if (ImGui::CollapsingHeader("Frame Times"))
+                    frameTimes.OnImGui();
+                ImGui::Separator();
+                // Opens in chrome://tracing or ui.perfetto.dev
+                ImGui::SliderInt("Trace Frames", &traceFrames, 1, 1000);
+                if (ImGui::Button("Capture Trace"))
+                {
+                    if (Profiler::ExportChromeTrace("close2gl_trace.json", (unsigned int)traceFrames))
+                        std::cout << "Wrote the last " << traceFrames << " frames to close2gl_trace.json" << std::endl;
+                    else
+                        std::cout << "Could not write close2gl_trace.json" << std::endl;
+                }
                 ImGui::Separator();
                 pCamera->OnImGui();
                 ImGui::Separator();
@@ -145,8 +168,24 @@ int main()
                     ResetEngine();
                 }
 
-                m_CurrentScene->OnUpdate(deltaTime);
+                {
+                    PROFILE_SCOPE("Scene Update");
+                    Timer updateTimer;
+                    m_CurrentScene->OnUpdate(deltaTime);
+                    frameTimes.Add(FrameTimes::SCENE_UPDATE, updateTimer.duration_ms_now());
+                }
+
+                // Rendered and uploaded only when the scene presented a new software rasterized frame
+                if (Rasterizer::GetPresentedFrame() != presentedFrame)
+                {
+                    presentedFrame = Rasterizer::GetPresentedFrame();
+                    frameTimes.Add(FrameTimes::RASTER, Rasterizer::GetRenderTime() * 1000);
+                    frameTimes.Add(FrameTimes::UPLOAD, Rasterizer::GetUploadTime() * 1000);
+                }
+
+                Timer sceneImGuiTimer;
                 m_CurrentScene->OnImGuiRender();
+                frameTimes.Add(FrameTimes::IMGUI, sceneImGuiTimer.duration_ms_now());
                 m_LinesDrawer.OnUpdate(m_DebugLineShader, ogl::Camera(pCamera->GetBaseInfo()), (float)*pScreenWidth / (float)*pScreenHeight);
             }
             ImGui::End();
@@ -154,10 +193,15 @@ int main()
             pViewport->OnRender();
             pViewport->OnImGuiRender();
 
+            Timer imGuiTimer;
             UpdateImGui();
+            frameTimes.Add(FrameTimes::IMGUI, imGuiTimer.duration_ms_now());
 
             glfwSwapBuffers(pWindow);
             glfwPollEvents();
+
+            frameTimes.Add(FrameTimes::FRAME, frameTimer.duration_ms_now());
+            frameTimes.EndFrame();
         }
     }
     catch (std::exception e)
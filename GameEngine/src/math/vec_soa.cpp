@@ -0,0 +1,128 @@
+#include "vec_soa.h"
+
+#include <immintrin.h>
+
+namespace
+{
+#if defined(__AVX2__)
+	using lane = __m256;
+	constexpr size_t LANE_WIDTH = 8;
+
+	inline lane lane_load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void lane_store(float* p, lane v) { _mm256_storeu_ps(p, v); }
+	inline lane lane_set(float f) { return _mm256_set1_ps(f); }
+	inline lane lane_add(lane a, lane b) { return _mm256_add_ps(a, b); }
+	inline lane lane_mul(lane a, lane b) { return _mm256_mul_ps(a, b); }
+	inline lane lane_div(lane a, lane b) { return _mm256_div_ps(a, b); }
+#else
+	using lane = __m128;
+	constexpr size_t LANE_WIDTH = 4;
+
+	inline lane lane_load(const float* p) { return _mm_loadu_ps(p); }
+	inline void lane_store(float* p, lane v) { _mm_storeu_ps(p, v); }
+	inline lane lane_set(float f) { return _mm_set1_ps(f); }
+	inline lane lane_add(lane a, lane b) { return _mm_add_ps(a, b); }
+	inline lane lane_mul(lane a, lane b) { return _mm_mul_ps(a, b); }
+	inline lane lane_div(lane a, lane b) { return _mm_div_ps(a, b); }
+#endif
+
+	constexpr size_t PADDING = 8;
+	static_assert(PADDING % LANE_WIDTH == 0);
+
+	inline size_t padded(size_t n) { return (n + PADDING - 1) / PADDING * PADDING; }
+
+	// One row of a matrix broadcast to every lane
+	struct row
+	{
+		lane m0, m1, m2, m3;
+
+		row(const cgl::mat4& m, int i)
+			:m0(lane_set(m.mat[i][0])), m1(lane_set(m.mat[i][1])), m2(lane_set(m.mat[i][2])), m3(lane_set(m.mat[i][3])) {}
+
+		// Same operation order as vec4::dot
+		lane dot(lane x, lane y, lane z, lane w) const
+		{
+			return lane_add(lane_add(lane_add(lane_mul(m0, x), lane_mul(m1, y)), lane_mul(m2, z)), lane_mul(m3, w));
+		}
+	};
+}
+
+namespace cgl
+{
+	void vec3_soa::resize(size_t n)
+	{
+		count = n;
+		x.assign(padded(n), 0.0f);
+		y.assign(padded(n), 0.0f);
+		z.assign(padded(n), 0.0f);
+	}
+
+	void vec4_soa::resize(size_t n)
+	{
+		count = n;
+		x.resize(padded(n));
+		y.resize(padded(n));
+		z.resize(padded(n));
+		w.resize(padded(n));
+	}
+
+	void transform_points(const mat4& mvp, const mat4& viewport, const vec3_soa& points, vec4_soa& clip, vec4_soa& screen)
+	{
+		clip.resize(points.size());
+		screen.resize(points.size());
+
+		const row p0(mvp, 0), p1(mvp, 1), p2(mvp, 2), p3(mvp, 3);
+		const row v0(viewport, 0), v1(viewport, 1), v2(viewport, 2);
+		const lane one = lane_set(1.0f);
+
+		for (size_t i = 0; i < points.x.size(); i += LANE_WIDTH)
+		{
+			lane x = lane_load(&points.x[i]);
+			lane y = lane_load(&points.y[i]);
+			lane z = lane_load(&points.z[i]);
+
+			// Homogeneus clipping space
+			lane cx = p0.dot(x, y, z, one);
+			lane cy = p1.dot(x, y, z, one);
+			lane cz = p2.dot(x, y, z, one);
+			lane cw = p3.dot(x, y, z, one);
+
+			lane_store(&clip.x[i], cx);
+			lane_store(&clip.y[i], cy);
+			lane_store(&clip.z[i], cz);
+			lane_store(&clip.w[i], cw);
+
+			// Normalized device coordinates
+			lane inv_w = lane_div(one, cw);
+			lane nx = lane_mul(cx, inv_w);
+			lane ny = lane_mul(cy, inv_w);
+			lane nz = lane_mul(cz, inv_w);
+
+			// Pixel coordinates
+			lane_store(&screen.x[i], v0.dot(nx, ny, nz, one));
+			lane_store(&screen.y[i], v1.dot(nx, ny, nz, one));
+			lane_store(&screen.z[i], v2.dot(nx, ny, nz, one));
+			lane_store(&screen.w[i], cw);
+		}
+	}
+
+	void transform_vectors(const mat4& m, const vec3_soa& vectors, float w, vec4_soa& out)
+	{
+		out.resize(vectors.size());
+
+		const row r0(m, 0), r1(m, 1), r2(m, 2), r3(m, 3);
+		const lane lw = lane_set(w);
+
+		for (size_t i = 0; i < vectors.x.size(); i += LANE_WIDTH)
+		{
+			lane x = lane_load(&vectors.x[i]);
+			lane y = lane_load(&vectors.y[i]);
+			lane z = lane_load(&vectors.z[i]);
+
+			lane_store(&out.x[i], r0.dot(x, y, z, lw));
+			lane_store(&out.y[i], r1.dot(x, y, z, lw));
+			lane_store(&out.z[i], r2.dot(x, y, z, lw));
+			lane_store(&out.w[i], r3.dot(x, y, z, lw));
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <GLM/glm.hpp>
+
+#include "vec4.h"
+#include "mat4.h"
+
+namespace cgl
+{
+	// Structure of arrays of 3 component vectors. Every array is padded with
+	// zeros up to a multiple of 8, so SIMD loops never need a scalar tail
+	struct vec3_soa
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+
+		void resize(size_t n);
+		size_t size() const { return count; }
+
+		void set(size_t i, const glm::vec3& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+
+	private:
+		size_t count = 0;
+	};
+
+	// Structure of arrays of 4 component vectors, padded like vec3_soa
+	struct vec4_soa
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> w;
+
+		void resize(size_t n);
+		size_t size() const { return count; }
+
+		vec4 get(size_t i) const { return vec4(x[i], y[i], z[i], w[i]); }
+
+	private:
+		size_t count = 0;
+	};
+
+	// clip = mvp * (p, 1) and screen = viewport * (clip / clip.w) in a single pass,
+	// screen.w keeps clip.w for the perspective correct interpolation
+	void transform_points(const mat4& mvp, const mat4& viewport, const vec3_soa& points, vec4_soa& clip, vec4_soa& screen);
+
+	// out = m * (v, w)
+	void transform_vectors(const mat4& m, const vec3_soa& vectors, float w, vec4_soa& out);
+}
@@ -0,0 +1,53 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t initialSize)
+{
+	AddBlock(initialSize);
+}
+
+void FrameArena::Reset()
+{
+	// The frame did not fit, keep one block big enough for all of it
+	if (m_Blocks.size() > 1)
+	{
+		m_Blocks.clear();
+		m_Capacity = 0;
+		AddBlock(m_Used * 2);
+	}
+
+	m_Offset = 0;
+	m_Used = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+	const auto padding = [&](const Block& block) {
+		auto address = reinterpret_cast<std::uintptr_t>(block.data.get()) + m_Offset;
+		return (alignment - address % alignment) % alignment;
+	};
+
+	size_t pad = padding(m_Blocks.back());
+
+	if (m_Offset + pad + bytes > m_Blocks.back().size)
+	{
+		AddBlock(std::max(bytes + alignment, m_Blocks.back().size * 2));
+		pad = padding(m_Blocks.back());
+	}
+
+	std::byte* p = m_Blocks.back().data.get() + m_Offset + pad;
+
+	m_Used += pad + bytes;
+	m_Offset += pad + bytes;
+
+	return p;
+}
+
+void FrameArena::AddBlock(size_t size)
+{
+	m_Blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+	m_Offset = 0;
+	m_Capacity += size;
+}
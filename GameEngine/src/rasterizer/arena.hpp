@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Linear allocator for data that only lives during one draw. Allocations bump a
+// pointer and are never freed one by one, Reset() gives everything back at once.
+// When a frame needs more than the arena holds, extra blocks are taken from the
+// heap and merged into a single block on the next Reset(), so once the biggest
+// frame was seen the arena stops touching the heap
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+	FrameArena() : FrameArena(1 << 20) {}
+	explicit FrameArena(size_t initialSize);
+
+	void Reset();
+
+	template <typename _T>
+	_T* Allocate(size_t n) { return static_cast<_T*>(allocate(n * sizeof(_T), alignof(_T))); }
+
+	// Bytes handed out since the last Reset()
+	size_t Used() const { return m_Used; }
+	// Bytes owned by the arena
+	size_t Capacity() const { return m_Capacity; }
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+
+	void AddBlock(size_t size);
+
+	std::vector<Block> m_Blocks;
+	size_t m_Offset = 0;
+	size_t m_Used = 0;
+	size_t m_Capacity = 0;
+};
+
+// Container backed by a FrameArena, it must be emptied before the arena is reset
+template <typename _T>
+using ArenaVector = std::pmr::vector<_T>;
@@ -0,0 +1,177 @@
+#include "rasterizer.hpp"
+
+void Rasterizer::SubmitFrame(RasterizerFrame frame)
+{
+	const uint64_t id = ++m_SubmittedFrames;
+	const auto submitted = std::chrono::steady_clock::now();
+	m_SubmittedPixels = (size_t)frame.width * frame.height;
+
+	if (!m_IsAsync)
+	{
+		RenderFrame(frame);
+		PublishFrame(id, submitted);
+		return;
+	}
+
+	{
+		std::lock_guard lock(m_FrameMutex);
+
+		// The oldest frame waiting is already stale, dropping it keeps the latency bounded
+		while (m_PendingFrames.size() >= m_QueueDepth)
+		{
+			m_PendingFrames.pop_front();
+			++m_DroppedFrames;
+		}
+		m_PendingFrames.push_back({ std::move(frame), id, submitted });
+	}
+	m_FrameSubmitted.notify_one();
+}
+
+const FrameBuffer* Rasterizer::TakeFrame()
+{
+	std::lock_guard lock(m_FrameMutex);
+	if (!m_IsReady)
+		return nullptr;
+
+	MarkPresented();
+	return &m_ReadyBuffer;
+}
+
+void Rasterizer::MarkPresented()
+{
+	m_Stats = m_ReadyStats;
+	m_PresentedFrame = m_ReadyFrame;
+	m_FrameLatency = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_ReadySubmitted).count();
+	m_IsReady = false;
+}
+
+void Rasterizer::SetAsync(bool enabled, unsigned int queueDepth)
+{
+	{
+		std::lock_guard lock(m_FrameMutex);
+		m_QueueDepth = std::max(queueDepth, 1u);
+	}
+
+	if (enabled == m_IsAsync)
+		return;
+
+	if (enabled)
+	{
+		m_StopRenderThread = false;
+		m_RenderThread = std::thread(&Rasterizer::RenderThread);
+	}
+	else
+	{
+		// Frames already queued are still rendered
+		{
+			std::lock_guard lock(m_FrameMutex);
+			m_StopRenderThread = true;
+		}
+		m_FrameSubmitted.notify_one();
+		m_RenderThread.join();
+	}
+
+	m_IsAsync = enabled;
+}
+
+void Rasterizer::WaitIdle()
+{
+	std::unique_lock lock(m_FrameMutex);
+	m_FrameRendered.wait(lock, [] { return m_PendingFrames.empty() && !m_IsRendering; });
+}
+
+void Rasterizer::RenderThread()
+{
+	Profiler::SetThreadName("Render");
+
+	for (;;)
+	{
+		PendingFrame pending;
+		{
+			std::unique_lock lock(m_FrameMutex);
+			m_FrameSubmitted.wait(lock, [] { return m_StopRenderThread || !m_PendingFrames.empty(); });
+			if (m_PendingFrames.empty())
+				return;
+
+			pending = std::move(m_PendingFrames.front());
+			m_PendingFrames.pop_front();
+			m_IsRendering = true;
+		}
+
+		RenderFrame(pending.frame);
+		PublishFrame(pending.id, pending.submitted);
+	}
+}
+
+void Rasterizer::RenderFrame(const RasterizerFrame& frame)
+{
+	PROFILE_SCOPE("Render Frame");
+	const auto start = std::chrono::steady_clock::now();
+
+	SetViewPort(frame.width, frame.height);
+	SetTiledRendering(frame.isTiled, frame.threadCount, frame.tileSize);
+	SetTraversal(frame.traversal);
+	SetHiZ(frame.isHiZ);
+	SetFrustumCulling(frame.isFrustumCulling);
+	SetDeferredShading(frame.isDeferred);
+	SetDepthFormat(frame.depthFormat);
+	SetClearColor(frame.clearColor);
+	ClearFrameBuffer();
+	ClearZBuffer();
+
+	m_FrameDraws.clear();
+	BeginCapture(frame.heatmap != HEATMAP::NONE || !frame.capturePath.empty());
+
+	for (const auto& draw : frame.draws)
+	{
+		DrawSoftwareRasterized(
+			*draw.model,
+			draw.transform,
+			frame.camera,
+			frame.light,
+			frame.primitive,
+			frame.shading,
+			frame.showTextures,
+			frame.isCulling,
+			frame.isCullingClockWise,
+			frame.filtering
+		);
+	}
+
+	// Blocks nothing was drawn on still need the clear color
+	m_FrameBuffer.Resolve();
+
+	if (m_IsCapturing)
+	{
+		if (!frame.capturePath.empty() && !DumpCapture(frame.capturePath))
+			std::cout << "Could not write the capture " << frame.capturePath << std::endl;
+		DrawHeatmap(frame.heatmap);
+	}
+
+	m_RenderTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Rasterizer::PublishFrame(uint64_t id, std::chrono::steady_clock::time_point submitted)
+{
+	RasterizerStats stats;
+	stats.texturingTime = timer_fragment_shader.duration();
+	stats.heapAllocations = m_HeapAllocations;
+	stats.arenaUsage = m_Arena.Used();
+	stats.renderTime = m_RenderTime;
+	stats.draws = m_FrameDraws;
+	for (const auto& draw : m_FrameDraws)
+		stats.pipeline += draw;
+
+	{
+		std::lock_guard lock(m_FrameMutex);
+
+		// The previous ready buffer is drawn on next, whether it was presented or not
+		std::swap(m_FrameBuffer, m_ReadyBuffer);
+		m_IsReady = true;
+		m_ReadyFrame = id;
+		m_ReadySubmitted = submitted;
+		m_ReadyStats = stats;
+		m_IsRendering = false;
+	}
+	m_FrameRendered.notify_all();
+}
@@ -0,0 +1,87 @@
+#include "rasterizer.hpp"
+
+#include <fstream>
+
+namespace
+{
+	// Overdraw is drawn on a fixed scale so frames can be compared, more is red
+	constexpr float OVERDRAW_SCALE = 8.0f;
+
+	// Black at 0, then blue, cyan, green, yellow and red at 1
+	Pixel FalseColor(float t)
+	{
+		static const float stops[][3] = {
+			{ 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 1.0f, 1.0f },
+			{ 0.0f, 1.0f, 0.0f },
+			{ 1.0f, 1.0f, 0.0f },
+			{ 1.0f, 0.0f, 0.0f }
+		};
+		constexpr int last = (int)std::size(stops) - 1;
+
+		t = std::clamp(t, 0.0f, 1.0f) * (float)last;
+		int i = std::min((int)t, last - 1);
+		float f = t - (float)i;
+
+		return pack_rgba8(
+			stops[i][0] + (stops[i + 1][0] - stops[i][0]) * f,
+			stops[i][1] + (stops[i + 1][1] - stops[i][1]) * f,
+			stops[i][2] + (stops[i + 1][2] - stops[i][2]) * f);
+	}
+
+	template <typename _T>
+	bool WriteRaw(const std::string& path, const std::vector<_T>& values)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(values.data()), (std::streamsize)(values.size() * sizeof(_T)));
+		return (bool)file;
+	}
+}
+
+void Rasterizer::BeginCapture(bool enabled)
+{
+	m_IsCapturing = enabled;
+	if (!enabled)
+		return;
+
+	m_Overdraw.assign((size_t)m_screenWidth * m_screenHeight, 0);
+	m_TileCost.assign(m_Tiles.size(), 0);
+}
+
+void Rasterizer::DrawHeatmap(HEATMAP heatmap)
+{
+	if (heatmap == HEATMAP::OVERDRAW)
+	{
+		for (unsigned int y = 0; y < m_screenHeight; ++y)
+			for (unsigned int x = 0; x < m_screenWidth; ++x)
+				m_FrameBuffer.set(y, x, FalseColor((float)m_Overdraw[(size_t)y * m_screenWidth + x] / OVERDRAW_SCALE));
+	}
+	else if (heatmap == HEATMAP::TILE_COST)
+	{
+		// Relative to the most expensive tile of the frame
+		const uint64_t maxCost = std::max<uint64_t>(1, *std::max_element(m_TileCost.begin(), m_TileCost.end()));
+
+		for (size_t t = 0; t < m_Tiles.size(); ++t)
+		{
+			const Pixel color = FalseColor((float)m_TileCost[t] / (float)maxCost);
+			const TileRect& rect = m_Tiles[t].rect;
+
+			for (int y = rect.y0; y < rect.y1; ++y)
+				for (int x = rect.x0; x < rect.x1; ++x)
+					m_FrameBuffer.set(y, x, color);
+		}
+	}
+}
+
+bool Rasterizer::DumpCapture(const std::string& path)
+{
+	// Top row first, little endian like the machines it runs on
+	std::ofstream info(path + ".txt");
+	info << "overdraw " << path << "_overdraw.raw uint32 " << m_screenWidth << " x " << m_screenHeight << "\n";
+	info << "tile_cost " << path << "_tiles.raw uint64_ns " << m_TilesX << " x " << m_TilesY << " tile_size " << m_TileSize << "\n";
+
+	return (bool)info
+		&& WriteRaw(path + "_overdraw.raw", m_Overdraw)
+		&& WriteRaw(path + "_tiles.raw", m_TileCost);
+}
@@ -0,0 +1,201 @@
+#include "rasterizer.hpp"
+
+namespace
+{
+	// Vertices can go this many pixels away from the screen before x/y clipping
+	// is needed, inside of it the rasterizers bounds take care of the overflow.
+	// Also keeps the integer edge functions of the half-space traversal small
+	constexpr float GUARD_BAND = 8192.0f;
+
+	enum ClipPlane : unsigned int
+	{
+		CLIP_NEAR   = 1 << 0,
+		CLIP_FAR    = 1 << 1,
+		CLIP_LEFT   = 1 << 2,
+		CLIP_RIGHT  = 1 << 3,
+		CLIP_BOTTOM = 1 << 4,
+		CLIP_TOP    = 1 << 5
+	};
+
+	constexpr unsigned int PLANE_COUNT = 6;
+
+	// Each plane adds at most one vertex to the polygon
+	constexpr unsigned int MAX_CLIP_VERTICES = 3 + PLANE_COUNT;
+
+	// Planes the vertex is outside of, gx and gy scale the x and y planes
+	// (1 for the view volume, bigger for the guard band)
+	inline unsigned int Outcode(const cgl::vec4& p, float gx, float gy)
+	{
+		unsigned int code = 0;
+		if (p.z < -p.w)      code |= CLIP_NEAR;
+		if (p.z >  p.w)      code |= CLIP_FAR;
+		if (p.x < -gx * p.w) code |= CLIP_LEFT;
+		if (p.x >  gx * p.w) code |= CLIP_RIGHT;
+		if (p.y < -gy * p.w) code |= CLIP_BOTTOM;
+		if (p.y >  gy * p.w) code |= CLIP_TOP;
+		return code;
+	}
+
+	// Signed distance to the plane, positive inside
+	inline float PlaneDistance(unsigned int plane, const cgl::vec4& p, float gx, float gy)
+	{
+		switch (plane)
+		{
+		case CLIP_NEAR:   return p.w + p.z;
+		case CLIP_FAR:    return p.w - p.z;
+		case CLIP_LEFT:   return gx * p.w + p.x;
+		case CLIP_RIGHT:  return gx * p.w - p.x;
+		case CLIP_BOTTOM: return gy * p.w + p.y;
+		default:          return gy * p.w - p.y;
+		}
+	}
+
+	// Orientation of the projected triangle, valid even when it crosses the
+	// plane w = 0 (Olano and Greer, triangle scan conversion using 2DH coordinates)
+	inline float Orientation(const cgl::vec4& v0, const cgl::vec4& v1, const cgl::vec4& v2)
+	{
+		return v0.x * (v1.y * v2.w - v2.y * v1.w)
+			 - v0.y * (v1.x * v2.w - v2.x * v1.w)
+			 + v0.w * (v1.x * v2.y - v2.x * v1.y);
+	}
+
+	// Clip space vertex, attributes are not divided by w
+	struct ClipVertex
+	{
+		cgl::vec4 position;
+		cgl::vec4 color;
+		cgl::vec4 normal;
+		cgl::vec3 uv;
+
+		static ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t)
+		{
+			return {
+				a.position + (b.position - a.position) * t,
+				a.color    + (b.color    - a.color)    * t,
+				a.normal   + (b.normal   - a.normal)   * t,
+				a.uv       + (b.uv       - a.uv)       * t
+			};
+		}
+	};
+
+	inline float GuardBandScale(unsigned int screenSize)
+	{
+		return 2.0f * GUARD_BAND / (float)screenSize - 1.0f;
+	}
+}
+
+void Rasterizer::AssembleTriangles(const Mesh& mesh, unsigned int base, const Texture* texture, const cgl::mat4& viewport, bool isCulling, bool isCullingClockWise)
+{
+	const float gx = GuardBandScale(m_screenWidth);
+	const float gy = GuardBandScale(m_screenHeight);
+
+	// Meshes without an index buffer are plain triangle lists
+	const bool isIndexed = !mesh.indices.empty();
+	const unsigned int count = isIndexed ? (unsigned int)mesh.indices.size() : (unsigned int)mesh.vertices.size();
+
+	for (unsigned int j = 0; j + 2 < count; j += 3)
+	{
+		unsigned int i0 = isIndexed ? mesh.indices[j + 0] : j + 0;
+		unsigned int i1 = isIndexed ? mesh.indices[j + 1] : j + 1;
+		unsigned int i2 = isIndexed ? mesh.indices[j + 2] : j + 2;
+
+		const cgl::vec4 v[3] = { m_ClipStream.get(i0), m_ClipStream.get(i1), m_ClipStream.get(i2) };
+
+		// Trivial reject, all vertices outside of the same plane of the view volume
+		if (Outcode(v[0], 1.0f, 1.0f) & Outcode(v[1], 1.0f, 1.0f) & Outcode(v[2], 1.0f, 1.0f))
+			continue;
+
+		// Culling
+		if (isCulling)
+		{
+			float sign = Orientation(v[0], v[1], v[2]);
+			if ((isCullingClockWise && sign > 0.0f) || (!isCullingClockWise && sign < 0.0f))
+			{
+				++m_DrawStatistics.trianglesCulled;
+				continue;
+			}
+		}
+
+		// Only triangles crossing the near or far plane, or leaving the guard band, are clipped
+		unsigned int clipCodes = Outcode(v[0], gx, gy) | Outcode(v[1], gx, gy) | Outcode(v[2], gx, gy);
+
+		if (clipCodes == 0)
+		{
+			m_Triangles.push_back({ base + i0, base + i1, base + i2, texture });
+			continue;
+		}
+
+		++m_DrawStatistics.trianglesClipped;
+
+		const unsigned int index[3] = { base + i0, base + i1, base + i2 };
+		ClipTriangle(index, v, clipCodes, texture, viewport);
+	}
+}
+
+void Rasterizer::ClipTriangle(const unsigned int index[3], const cgl::vec4 clip[3], unsigned int clipCodes, const Texture* texture, const cgl::mat4& viewport)
+{
+	const float gx = GuardBandScale(m_screenWidth);
+	const float gy = GuardBandScale(m_screenHeight);
+
+	// Undo the perspective division of the stored attributes
+	std::array<ClipVertex, MAX_CLIP_VERTICES> polygon;
+	for (int i = 0; i < 3; ++i)
+	{
+		float w = clip[i].w;
+		polygon[i] = { clip[i], m_Colors[index[i]] * w, m_Normals[index[i]] * w, m_UVs[index[i]] * w };
+	}
+	unsigned int polygonSize = 3;
+
+	// Sutherland-Hodgman, only against the planes crossed by the triangle
+	std::array<ClipVertex, MAX_CLIP_VERTICES> clipped;
+	for (unsigned int plane = 1; plane < (1u << PLANE_COUNT) && polygonSize >= 3; plane <<= 1)
+	{
+		if (!(clipCodes & plane))
+			continue;
+
+		unsigned int clippedSize = 0;
+		for (unsigned int i = 0; i < polygonSize; ++i)
+		{
+			const ClipVertex& a = polygon[i];
+			const ClipVertex& b = polygon[(i + 1) % polygonSize];
+
+			float da = PlaneDistance(plane, a.position, gx, gy);
+			float db = PlaneDistance(plane, b.position, gx, gy);
+
+			if (da >= 0.0f)
+				clipped[clippedSize++] = a;
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+				clipped[clippedSize++] = ClipVertex::Lerp(a, b, da / (da - db));
+		}
+
+		polygon = clipped;
+		polygonSize = clippedSize;
+	}
+
+	if (polygonSize < 3)
+		return;
+
+	// New vertices go through the same steps as the ones of the vertex stage
+	unsigned int first = (unsigned int)m_Vertices.size();
+	for (unsigned int i = 0; i < polygonSize; ++i)
+	{
+		const ClipVertex& vertex = polygon[i];
+		float w = vertex.position.w;
+
+		cgl::vec4 position = vertex.position;
+		position /= w;
+		position = viewport * position;
+		position.w = w;
+		position.z = DepthKey(position);
+
+		m_Vertices.push_back(position);
+		m_Colors.push_back(vertex.color * (1 / w));
+		m_Normals.push_back(vertex.normal * (1 / w));
+		m_UVs.push_back(vertex.uv * (1 / w));
+	}
+
+	// Clipping a triangle against planes keeps it convex, so a fan covers it
+	for (unsigned int i = 1; i + 1 < polygonSize; ++i)
+		m_Triangles.push_back({ first, first + i, first + i + 1, texture });
+}
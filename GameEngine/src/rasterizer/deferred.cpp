@@ -0,0 +1,125 @@
+#include "rasterizer.hpp"
+#include "fragment.hpp"
+
+ShadeKernel Rasterizer::VisibilityKernel(bool textured)
+{
+	// Resolving does not touch the depth buffer, any format gives the same kernel
+	return SelectShading<DEPTH_FORMAT::FLOAT32>(textured, []<typename C>() -> ShadeKernel { return &ShadeSample<C>; });
+}
+
+template <typename C>
+void Rasterizer::ShadeSample(const RasterTriangle& triangle, const VisibilityQuad& quad, const cgl::vec3& stepX, const cgl::vec3& stepY)
+{
+	const unsigned int v0 = triangle.v0;
+	const unsigned int v1 = triangle.v1;
+	const unsigned int v2 = triangle.v2;
+
+	const auto c0 = load_varying<C::hasColor>(m_Colors[v0]);
+	const auto c1 = load_varying<C::hasColor>(m_Colors[v1]);
+	const auto c2 = load_varying<C::hasColor>(m_Colors[v2]);
+
+	const auto n0 = load_varying<C::hasNormal>(m_Normals[v0]);
+	const auto n1 = load_varying<C::hasNormal>(m_Normals[v1]);
+	const auto n2 = load_varying<C::hasNormal>(m_Normals[v2]);
+
+	const auto uv0 = load_varying<C::hasUV>(m_UVs[v0]);
+	const auto uv1 = load_varying<C::hasUV>(m_UVs[v1]);
+	const auto uv2 = load_varying<C::hasUV>(m_UVs[v2]);
+
+	FragmentBatch<C> batch;
+	float lod = 0.0f;
+
+	for (int i = 0; i < quad.count; ++i)
+	{
+		const float w1 = quad.b1[i];
+		const float w2 = quad.b2[i];
+		const float w0 = 1.0f - w1 - w2;
+
+		typename C::Color  pixelColorPC  = c0  * w0 + c1  * w1 + c2  * w2;
+		typename C::Normal pixelNormalPC = n0  * w0 + n1  * w1 + n2  * w2;
+		typename C::UV     pixelUVPC     = uv0 * w0 + uv1 * w1 + uv2 * w2;
+
+		if constexpr (C::hasLod)
+		{
+			if (i == 0)
+			{
+				typename C::UV ddx = uv0 * stepX.x + uv1 * stepX.y + uv2 * stepX.z;
+				typename C::UV ddy = uv0 * stepY.x + uv1 * stepY.y + uv2 * stepY.z;
+				lod = QuadLod<C>(pixelUVPC, ddx, ddy, triangle.texture);
+			}
+		}
+
+		batch.Add(quad.x[i], quad.y[i], pixelColorPC, pixelNormalPC, pixelUVPC, lod);
+	}
+
+	ShadeBatch<C>(batch, triangle.texture);
+}
+
+void Rasterizer::ShadeVisibilityBuffer(const TileRect& rect)
+{
+	// Neighbouring pixels mostly belong to the same triangle, keep its setup around
+	unsigned int current = VisibilitySample::EMPTY;
+	const RasterTriangle* triangle = nullptr;
+	ShadeKernel shade = nullptr;
+	cgl::vec3 stepX, stepY;
+
+	PipelineStatistics& stats = WorkerStatistics();
+	const size_t filter = FilteringIndex(m_Filtering);
+	const unsigned int texels = TexelsPerFragment(m_Filtering);
+
+	auto flush = [&](VisibilityQuad& quad)
+	{
+		shade(*triangle, quad, stepX, stepY);
+
+		if (triangle->texture)
+			stats.texelsFetched[filter] += texels * quad.count;
+		stats.pixelsWritten += quad.count;
+		quad.count = 0;
+	};
+
+	// Pixels are shaded by 2x2 quads, aligned to the screen
+	for (int qy = rect.y0 & ~1; qy < rect.y1; qy += 2)
+	{
+		for (int qx = rect.x0 & ~1; qx < rect.x1; qx += 2)
+		{
+			// The pixels of each triangle of the quad are shaded together with one level
+			// of detail, nearly always a single triangle
+			VisibilityQuad quad;
+
+			for (int y = std::max(qy, rect.y0); y < std::min(qy + 2, rect.y1); ++y)
+			{
+				VisibilitySample* row = m_VisibilityBuffer.data() + (m_VisibilityBuffer.height() - 1 - y) * m_VisibilityBuffer.width();
+
+				for (int x = std::max(qx, rect.x0); x < std::min(qx + 2, rect.x1); ++x)
+				{
+					VisibilitySample& sample = row[x];
+					if (sample.triangle == VisibilitySample::EMPTY)
+						continue;
+
+					if (sample.triangle != current)
+					{
+						if (quad.count)
+							flush(quad);
+
+						current = sample.triangle;
+						triangle = &m_Triangles[current];
+						shade = m_ShadeKernels[triangle->texture != nullptr];
+						BarycentricSteps(m_Vertices[triangle->v0], m_Vertices[triangle->v1], m_Vertices[triangle->v2], stepX, stepY);
+					}
+
+					quad.x[quad.count] = x;
+					quad.y[quad.count] = y;
+					quad.b1[quad.count] = sample.b1;
+					quad.b2[quad.count] = sample.b2;
+					++quad.count;
+
+					// Triangle indices are only valid during this draw
+					sample.triangle = VisibilitySample::EMPTY;
+				}
+			}
+
+			if (quad.count)
+				flush(quad);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#include "depth.hpp"
+
+namespace
+{
+	size_t BytesPerPixel(DEPTH_FORMAT format)
+	{
+		switch (format)
+		{
+		case DEPTH_FORMAT::UNORM16: return 2;
+		case DEPTH_FORMAT::UNORM24: return 3;
+		default:                    return 4;
+		}
+	}
+}
+
+void DepthBuffer::resize(unsigned int height, unsigned int width)
+{
+	if (height == m_Height && width == m_Width)
+		return;
+
+	m_Height = height;
+	m_Width = width;
+	Allocate();
+}
+
+void DepthBuffer::SetFormat(DEPTH_FORMAT format)
+{
+	if (format == m_Format)
+		return;
+
+	m_Format = format;
+	Allocate();
+	clear();
+}
+
+void DepthBuffer::Allocate()
+{
+	// Rows padded to whole groups of 8 pixels plus one word, so 8 pixel loads
+	// and 32 bits reads of a packed pixel never leave the row
+	m_Stride = ((m_Width + 7) / 8 * 8 * BytesPerPixel(m_Format) + 4 + 31) / 32 * 32;
+	m_Data.resize(m_Stride * m_Height);
+}
+
+void DepthBuffer::clear()
+{
+	if (m_Data.empty())
+		return;
+
+	switch (m_Format)
+	{
+	// Far is all ones for the unorm formats and zero for reversed z, plain byte fills
+	case DEPTH_FORMAT::UNORM16:
+	case DEPTH_FORMAT::UNORM24:
+		std::memset(m_Data.data(), 0xFF, m_Data.size());
+		break;
+
+	case DEPTH_FORMAT::FLOAT32_REVERSED:
+		std::memset(m_Data.data(), 0, m_Data.size());
+		break;
+
+	default:
+	{
+		// The size is a multiple of 32 bytes
+		float* data = reinterpret_cast<float*>(m_Data.data());
+		const size_t count = m_Data.size() / sizeof(float);
+#if defined(__AVX2__)
+		const __m256 farthest = _mm256_set1_ps(std::numeric_limits<float>::max());
+		for (size_t i = 0; i < count; i += 8)
+			_mm256_storeu_ps(data + i, farthest);
+#else
+		const __m128 farthest = _mm_set1_ps(std::numeric_limits<float>::max());
+		for (size_t i = 0; i < count; i += 4)
+			_mm_storeu_ps(data + i, farthest);
+#endif
+		break;
+	}
+	}
+}
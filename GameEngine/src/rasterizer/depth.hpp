@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <immintrin.h>
+
+// Storage of the depth buffer. Vertices carry a depth key that is linear in
+// screen space and smaller when nearer, every format encodes that key
+enum class DEPTH_FORMAT
+{
+	// Key = NDC z remapped to [0, 1], stored as is
+	FLOAT32,
+	// Key = -1 / w, stored as 1 / w with a greater test and cleared to 0, so
+	// the dense floats near zero go to the far distances
+	FLOAT32_REVERSED,
+	// Key = NDC z remapped to [0, 1], quantized to 24 bits and packed in 3 bytes
+	UNORM24,
+	// Same, quantized to 16 bits
+	UNORM16
+};
+
+// Encoding and comparison of one format, Less8 tests 8 consecutive pixels
+template <DEPTH_FORMAT F>
+struct DepthFormat;
+
+template <>
+struct DepthFormat<DEPTH_FORMAT::FLOAT32>
+{
+	using Value = float;
+	static constexpr size_t BYTES = 4;
+
+	static Value Encode(float key) { return key; }
+	static float Decode(Value v) { return v; }
+	static bool Passes(Value v, Value stored) { return v < stored; }
+
+	static Value Load(const std::byte* row, int x) { Value v; std::memcpy(&v, row + x * BYTES, BYTES); return v; }
+	static void Store(std::byte* row, int x, Value v) { std::memcpy(row + x * BYTES, &v, BYTES); }
+
+#if defined(__AVX2__)
+	static unsigned int Passes8(__m256 keys, const std::byte* row)
+	{
+		return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(keys, _mm256_loadu_ps((const float*)row), _CMP_LT_OQ));
+	}
+#endif
+};
+
+template <>
+struct DepthFormat<DEPTH_FORMAT::FLOAT32_REVERSED>
+{
+	using Value = float;
+	static constexpr size_t BYTES = 4;
+
+	static Value Encode(float key) { return -key; }
+	static float Decode(Value v) { return -v; }
+	static bool Passes(Value v, Value stored) { return v > stored; }
+
+	static Value Load(const std::byte* row, int x) { Value v; std::memcpy(&v, row + x * BYTES, BYTES); return v; }
+	static void Store(std::byte* row, int x, Value v) { std::memcpy(row + x * BYTES, &v, BYTES); }
+
+#if defined(__AVX2__)
+	static unsigned int Passes8(__m256 keys, const std::byte* row)
+	{
+		__m256 values = _mm256_sub_ps(_mm256_setzero_ps(), keys);
+		return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(values, _mm256_loadu_ps((const float*)row), _CMP_GT_OQ));
+	}
+#endif
+};
+
+template <uint32_t BITS>
+struct DepthUnorm
+{
+	using Value = uint32_t;
+	static constexpr size_t BYTES = BITS / 8;
+	static constexpr Value MAX = (1u << BITS) - 1;
+
+	static Value Encode(float key) { return (Value)(std::clamp(key, 0.0f, 1.0f) * (float)MAX + 0.5f); }
+	static float Decode(Value v) { return (float)v * (1.0f / (float)MAX); }
+	static bool Passes(Value v, Value stored) { return v < stored; }
+
+	// Reads a whole 32 bits word, rows are padded so the last pixel can too
+	static Value Load(const std::byte* row, int x) { Value v; std::memcpy(&v, row + x * BYTES, 4); return v & MAX; }
+	static void Store(std::byte* row, int x, Value v) { std::memcpy(row + x * BYTES, &v, BYTES); }
+
+#if defined(__AVX2__)
+	static unsigned int Passes8(__m256 keys, const std::byte* row)
+	{
+		keys = _mm256_min_ps(_mm256_max_ps(keys, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		__m256i values = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(keys, _mm256_set1_ps((float)MAX)), _mm256_set1_ps(0.5f)));
+
+		__m256i stored;
+		if constexpr (BYTES == 2)
+			stored = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)row));
+		else
+			stored = _mm256_and_si256(_mm256_i32gather_epi32((const int*)row, _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21), 1), _mm256_set1_epi32((int)MAX));
+
+		// Both fit in 24 bits, the signed compare is fine
+		return (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(stored, values)));
+	}
+#endif
+};
+
+template <> struct DepthFormat<DEPTH_FORMAT::UNORM24> : DepthUnorm<24> {};
+template <> struct DepthFormat<DEPTH_FORMAT::UNORM16> : DepthUnorm<16> {};
+
+// Bit i is set when the key z0 + i * dz passes the depth test at pixel x + i of the row
+template <typename D>
+inline unsigned int DepthTest8(const std::byte* row, int x, float z0, float dz)
+{
+#if defined(__AVX2__)
+	__m256 keys = _mm256_add_ps(_mm256_set1_ps(z0), _mm256_mul_ps(_mm256_set1_ps(dz), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)));
+	return D::Passes8(keys, row + x * D::BYTES);
+#else
+	unsigned int mask = 0;
+	for (int i = 0; i < 8; ++i)
+		mask |= (unsigned int)D::Passes(D::Encode(z0 + dz * (float)i), D::Load(row, x + i)) << i;
+	return mask;
+#endif
+}
+
+class DepthBuffer
+{
+public:
+	void resize(unsigned int height, unsigned int width);
+	void SetFormat(DEPTH_FORMAT format);
+	DEPTH_FORMAT format() const { return m_Format; }
+
+	// Fills the buffer with the farthest value of the format
+	void clear();
+
+	// Rows are stored bottom up like the frame buffer
+	std::byte* row(int y) { return m_Data.data() + (m_Height - 1 - y) * m_Stride; }
+
+	size_t height() const { return m_Height; }
+	size_t width() const { return m_Width; }
+	size_t bytes() const { return m_Data.size(); }
+
+private:
+	void Allocate();
+
+	DEPTH_FORMAT m_Format = DEPTH_FORMAT::FLOAT32;
+	size_t m_Height = 0;
+	size_t m_Width = 0;
+	size_t m_Stride = 0;
+	std::vector<std::byte> m_Data;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "rasterizer.hpp"
+
+// Index of the tile worker running the caller, 0 outside of the parallel region
+inline int WorkerIndex()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+inline PipelineStatistics& Rasterizer::WorkerStatistics()
+{
+	return m_ThreadStatistics[WorkerIndex()];
+}
+
+// Change of the screen space barycentric weights of p0, p1 and p2 for one pixel
+// right (x) and one pixel down (y), zero for triangles without area
+inline void BarycentricSteps(const cgl::vec4& p0, const cgl::vec4& p1, const cgl::vec4& p2, cgl::vec3& stepX, cgl::vec3& stepY)
+{
+	float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+	if (area == 0.0f)
+	{
+		stepX = stepY = cgl::vec3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	float invArea = 1.0f / area;
+	stepX = cgl::vec3((p1.y - p2.y) * invArea, (p2.y - p0.y) * invArea, (p0.y - p1.y) * invArea);
+	stepY = cgl::vec3((p2.x - p1.x) * invArea, (p0.x - p2.x) * invArea, (p1.x - p0.x) * invArea);
+}
+
+template <typename C>
+float Rasterizer::QuadLod(const typename C::UV& uvPC, const typename C::UV& ddxPC, const typename C::UV& ddyPC, const Texture* texture)
+{
+	if constexpr (C::hasLod)
+	{
+		const SwizzledLevel& base = texture->GetLevel(0);
+		const cgl::vec2 size((float)base.width, (float)base.height);
+
+		const cgl::vec2 uv = (uvPC * (1 / uvPC.z)).to_vec2();
+		const typename C::UV right = uvPC + ddxPC;
+		const typename C::UV below = uvPC + ddyPC;
+
+		// In texels of the base level
+		const cgl::vec2 ddx = ((right * (1 / right.z)).to_vec2() - uv) * size;
+		const cgl::vec2 ddy = ((below * (1 / below.z)).to_vec2() - uv) * size;
+
+		return std::clamp(Texture::GetMipMapLevel(ddx, ddy), 0.0f, (float)(texture->GetLevelCount() - 1));
+	}
+	else
+	{
+		return 0.0f;
+	}
+}
+
+template <typename C>
+cgl::vec3 Rasterizer::LightFragment(const cgl::vec3& color, const typename C::Normal& pixelNormalPC)
+{
+	cgl::vec3 pixelColor = color;
+
+	if constexpr (C::shading == SHADING::PHONG)
+	{
+		cgl::vec3 pixelNormal = (pixelNormalPC * (1 / pixelNormalPC.w)).to_vec3().normalized();
+
+		auto dirLight = cgl::vec3(-m_DirectionalLight.direction).normalized();
+		auto diff = std::max(0.0f, dirLight.dot(pixelNormal));
+		auto diffuse = m_DirectionalLight.diffuse * pixelColor * diff;
+
+		auto ambient = m_DirectionalLight.ambient * pixelColor;
+
+		pixelColor = ambient + diffuse;
+	}
+
+	// else if (m_Shading == SHADING::NONE)
+
+	return pixelColor;
+}
+
+// Fragment stage shared by every kernel, only the branches of its configuration are compiled in
+template <typename C>
+void Rasterizer::ShadeBatch(FragmentBatch<C>& batch, const Texture* texture)
+{
+	constexpr int SIZE = FragmentBatch<C>::SIZE;
+	cgl::vec3 colors[SIZE];
+
+	if constexpr (C::textured)
+	{
+		// Lanes past the end of a partial batch repeat its last fragment
+		alignas(16) float u[SIZE], v[SIZE], lod[SIZE];
+		for (int i = 0; i < SIZE; ++i)
+		{
+			const int f = std::min(i, batch.count - 1);
+			cgl::vec2 pixelUV = (batch.uv[f] * (1 / batch.uv[f].z)).to_vec2();
+
+			u[i] = std::clamp(pixelUV.x, 0.0f, 1.0f);
+			v[i] = std::clamp(pixelUV.y, 0.0f, 1.0f);
+			lod[i] = batch.lod[f];
+		}
+
+		const SwizzledLevel& base = texture->GetLevel(0);
+
+		if constexpr (C::filtering == Texture::Filtering::NEAREST_NEIGHBOR)
+		{
+			for (int i = 0; i < batch.count; ++i)
+				colors[i] = Texture::GetPixelColorFromTextureBuffer(base,
+					std::floor(u[i] * (float)(texture->GetWidth()  - 1.0f)),
+					std::floor(v[i] * (float)(texture->GetHeight() - 1.0f)));
+		}
+
+		else if constexpr (C::filtering == Texture::Filtering::BILINEAR)
+		{
+			const SwizzledLevel* levels[SIZE] = { &base, &base, &base, &base };
+			for (int i = 0; i < SIZE; ++i)
+			{
+				u[i] *= (float)(texture->GetWidth()  - 1.0f);
+				v[i] *= (float)(texture->GetHeight() - 1.0f);
+			}
+
+			alignas(16) uint32_t texels[SIZE];
+			Texture::BilinearFiltering4(levels, u, v, texels);
+
+			for (int i = 0; i < batch.count; ++i)
+				colors[i] = Texture::TexelColor(texels[i]);
+		}
+
+		else if constexpr (C::filtering == Texture::Filtering::BICUBIC)
+		{
+			for (int i = 0; i < batch.count; ++i)
+				colors[i] = Texture::BicubicFiltering(base,
+					u[i] * (float)(texture->GetWidth()  - 1.0f),
+					v[i] * (float)(texture->GetHeight() - 1.0f));
+		}
+
+		else if constexpr (C::filtering == Texture::Filtering::TRILLINEAR)
+		{
+			alignas(16) uint32_t texels[SIZE];
+			texture->TrilinearFiltering4(u, v, lod, texels);
+
+			for (int i = 0; i < batch.count; ++i)
+				colors[i] = Texture::TexelColor(texels[i]);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < batch.count; ++i)
+			colors[i] = (batch.color[i] * (1 / batch.color[i].w)).to_vec3();
+	}
+
+	for (int i = 0; i < batch.count; ++i)
+		m_FrameBuffer.set(batch.y[i], batch.x[i], to_pixel(LightFragment<C>(colors[i], batch.normal[i])));
+
+	batch.count = 0;
+}
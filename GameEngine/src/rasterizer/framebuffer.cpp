@@ -0,0 +1,108 @@
+#include "framebuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void FrameBuffer::resize(unsigned int height, unsigned int width)
+{
+	if (height == m_Height && width == m_Width)
+		return;
+
+	m_Height = height;
+	m_Width = width;
+
+	if (!IsExternal() || m_Height * m_Width > m_Capacity)
+	{
+		// Cache line aligned, rows are aligned too whenever the width is a multiple of 16
+		m_Capacity = std::max<size_t>(m_Height * m_Width, 1);
+		m_Owned.reset(static_cast<Pixel*>(::operator new[](m_Capacity * sizeof(Pixel), std::align_val_t(64))));
+		m_Pixels = m_Owned.get();
+	}
+
+	ResizeBlocks();
+}
+
+void FrameBuffer::SetStorage(Pixel* pixels, size_t capacity, unsigned int height, unsigned int width)
+{
+	m_Owned.reset();
+	m_Pixels = pixels;
+	m_Capacity = capacity;
+	m_Height = height;
+	m_Width = width;
+
+	ResizeBlocks();
+}
+
+void FrameBuffer::Detach()
+{
+	if (!IsExternal())
+		return;
+
+	Pixel* external = m_Pixels;
+	m_Capacity = std::max<size_t>(m_Height * m_Width, 1);
+	m_Owned.reset(static_cast<Pixel*>(::operator new[](m_Capacity * sizeof(Pixel), std::align_val_t(64))));
+	m_Pixels = m_Owned.get();
+	std::memcpy(m_Pixels, external, m_Height * m_Width * sizeof(Pixel));
+}
+
+void FrameBuffer::ResizeBlocks()
+{
+	m_BlocksX = (int)(m_Width  + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_BlocksY = (int)(m_Height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_Cleared.assign((size_t)m_BlocksX * m_BlocksY, 1);
+}
+
+void FrameBuffer::clear(const Pixel& color)
+{
+	m_ClearColor = color;
+	std::memset(m_Cleared.data(), 1, m_Cleared.size());
+}
+
+void FrameBuffer::Touch(int bx0, int by0, int bx1, int by1)
+{
+	for (int by = by0; by < by1; ++by)
+	{
+		for (int bx = bx0; bx < bx1; ++bx)
+		{
+			unsigned char& cleared = m_Cleared[by * m_BlocksX + bx];
+			if (cleared)
+			{
+				FillBlock(bx, by);
+				cleared = 0;
+			}
+		}
+	}
+}
+
+void FrameBuffer::Resolve()
+{
+	Touch(0, 0, m_BlocksX, m_BlocksY);
+}
+
+void FrameBuffer::FillBlock(int bx, int by)
+{
+	const int x0 = bx * BLOCK_SIZE;
+	const int y0 = by * BLOCK_SIZE;
+	const int x1 = std::min(x0 + BLOCK_SIZE, (int)m_Width);
+	const int y1 = std::min(y0 + BLOCK_SIZE, (int)m_Height);
+
+	for (int y = y0; y < y1; ++y)
+	{
+		Pixel* row = m_Pixels + (m_Height - 1 - y) * m_Width;
+
+		// A whole row of the block is 32 bytes, one store
+		if (x1 - x0 == BLOCK_SIZE)
+		{
+#if defined(__AVX2__)
+			_mm256_storeu_si256((__m256i*)(row + x0), _mm256_set1_epi32((int)m_ClearColor.rgba));
+#else
+			_mm_storeu_si128((__m128i*)(row + x0), _mm_set1_epi32((int)m_ClearColor.rgba));
+			_mm_storeu_si128((__m128i*)(row + x0 + 4), _mm_set1_epi32((int)m_ClearColor.rgba));
+#endif
+		}
+		else
+		{
+			std::fill(row + x0, row + x1, m_ClearColor);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+#include <immintrin.h>
+
+#include <GLM/glm.hpp>
+
+#include "vec3.h"
+
+// 32 bits RGBA, every pixel is one aligned word
+struct Pixel
+{
+	union
+	{
+		struct
+		{
+			unsigned char r, g, b, a;
+		};
+		unsigned char p[4];
+		uint32_t rgba;
+	};
+};
+
+inline std::ostream& operator << (std::ostream& out, const Pixel& p)
+{
+	return out << (unsigned int)p.r << ','
+		<< (unsigned int)p.g << ','
+		<< (unsigned int)p.b;
+}
+
+// Scales to 0..255, truncates and saturates the four channels at once
+inline Pixel pack_rgba8(float r, float g, float b)
+{
+	__m128i v = _mm_cvttps_epi32(_mm_mul_ps(_mm_setr_ps(r, g, b, 1.0f), _mm_set1_ps(255.0f)));
+	v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+
+	Pixel p;
+	p.rgba = (uint32_t)_mm_cvtsi128_si32(v);
+	return p;
+}
+
+inline Pixel to_pixel(const glm::vec3& c)
+{
+	return pack_rgba8(c.x, c.y, c.z);
+}
+
+inline Pixel to_pixel(const cgl::vec3& c)
+{
+	return pack_rgba8(c.x, c.y, c.z);
+}
+
+// Color buffer of the software rasterizer. Clearing only flags its 8x8 blocks,
+// the clear color is written to a block when something is about to be drawn
+// on it (Touch) or when the buffer is presented (Resolve)
+class FrameBuffer
+{
+public:
+	static constexpr int BLOCK_SIZE = 8;
+
+	void resize(unsigned int height, unsigned int width);
+
+	// Draws into memory owned by someone else, like a mapped pixel buffer, that
+	// holds capacity pixels and outlives its use by the frame buffer. Later
+	// resizes keep using it while the pixels fit
+	void SetStorage(Pixel* pixels, size_t capacity, unsigned int height, unsigned int width);
+	// Copies the pixels into memory of its own and forgets the external one
+	void Detach();
+	bool IsExternal() const { return m_Pixels != nullptr && m_Pixels != m_Owned.get(); }
+
+	void clear(const Pixel& color);
+
+	// Materializes the cleared blocks of [bx0, bx1) x [by0, by1), in blocks
+	void Touch(int bx0, int by0, int bx1, int by1);
+	// Materializes every block still cleared
+	void Resolve();
+
+	// y - x, rows are stored bottom up
+	void set(unsigned int y, unsigned int x, const Pixel& p) { m_Pixels[(m_Height - 1 - y) * m_Width + x] = p; }
+	Pixel get(unsigned int y, unsigned int x) const { return m_Pixels[(m_Height - 1 - y) * m_Width + x]; }
+
+	Pixel* data() { return m_Pixels; }
+
+	size_t height() const { return m_Height; }
+	size_t width() const { return m_Width; }
+
+private:
+	void FillBlock(int bx, int by);
+	void ResizeBlocks();
+
+	struct AlignedDelete
+	{
+		void operator()(Pixel* p) const { ::operator delete[](p, std::align_val_t(64)); }
+	};
+
+	std::unique_ptr<Pixel[], AlignedDelete> m_Owned;
+	// Either m_Owned or the external storage
+	Pixel* m_Pixels = nullptr;
+	size_t m_Capacity = 0;
+	size_t m_Height = 0;
+	size_t m_Width = 0;
+
+	Pixel m_ClearColor{};
+	int m_BlocksX = 0;
+	int m_BlocksY = 0;
+	// One per block, set while the block still holds the previous frame
+	std::vector<unsigned char> m_Cleared;
+};
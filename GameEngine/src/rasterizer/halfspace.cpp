@@ -0,0 +1,370 @@
+#include "rasterizer.hpp"
+#include "fragment.hpp"
+
+#include <bit>
+#include <immintrin.h>
+
+namespace
+{
+	// Blocks match the hierarchical z buffer ones
+	constexpr int BLOCK_SIZE = HIZ_BLOCK_SIZE;
+
+	// Fractional bits of the snapped vertex positions of the sub-pixel traversal
+	constexpr int SUBPIXEL_BITS = 8;
+
+	// E(x, y) = A * x + B * y + C over positions with S fractional bits, positive
+	// inside of a counter clockwise triangle (after the area check below every
+	// triangle is made counter clockwise).
+	// Whole pixels fit in 32 bits, with sub-pixel positions the guard band
+	// takes the products past 2^31 so they are kept in 64 bits
+	template <int S>
+	struct EdgeFunction
+	{
+		using Int = std::conditional_t<S == 0, int, long long>;
+
+		Int A, B, C;
+
+		// Samples exactly on an edge belong only to the top or left edge,
+		// so pixels of shared edges are shaded by one of the two triangles
+		Int bias;
+
+		EdgeFunction(Int ax, Int ay, Int bx, Int by)
+		{
+			A = ay - by;
+			B = bx - ax;
+			C = -(A * ax + B * ay);
+			bias = (A > 0 || (A == 0 && B > 0)) ? 0 : -1;
+		}
+
+		// Whole pixels are sampled on the snapped grid itself, sub-pixel positions at the pixel center
+		static Int Sample(int p) { return ((Int)p << S) + (((Int)1 << S) >> 1); }
+
+		Int Evaluate(int x, int y) const { return A * Sample(x) + B * Sample(y) + C; }
+
+		// Change of the value from one pixel to the next
+		Int StepX() const { return A << S; }
+		Int StepY() const { return B << S; }
+	};
+
+	// Evaluates one edge on 8 consecutive pixels of a row at once
+	struct EdgeRow8
+	{
+#if defined(__AVX2__)
+		__m256i offsets;
+
+		explicit EdgeRow8(const EdgeFunction<0>& e)
+			:offsets(_mm256_mullo_epi32(_mm256_set1_epi32(e.A), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))) {}
+
+		__m256i Evaluate(int rowStart) const { return _mm256_add_epi32(_mm256_set1_epi32(rowStart), offsets); }
+#else
+		__m128i offsets_lo;
+		__m128i offsets_hi;
+
+		explicit EdgeRow8(const EdgeFunction<0>& e)
+			:offsets_lo(_mm_setr_epi32(0, e.A, 2 * e.A, 3 * e.A)),
+			 offsets_hi(_mm_setr_epi32(4 * e.A, 5 * e.A, 6 * e.A, 7 * e.A)) {}
+#endif
+	};
+
+	// 64 bit edges do not fit 8 lanes, their row is a plain loop
+	struct EdgeRow8Wide
+	{
+		long long step;
+
+		explicit EdgeRow8Wide(const EdgeFunction<SUBPIXEL_BITS>& e)
+			:step(e.StepX()) {}
+	};
+
+	template <int S>
+	using EdgeRow = std::conditional_t<S == 0, EdgeRow8, EdgeRow8Wide>;
+
+	// Bit i is set when pixel (x + i, y) is inside all three edges
+	inline unsigned int CoverageMask8(const EdgeFunction<0> edges[3], const EdgeRow8 rows[3], int x, int y)
+	{
+		int start0 = edges[0].Evaluate(x, y) + edges[0].bias;
+		int start1 = edges[1].Evaluate(x, y) + edges[1].bias;
+		int start2 = edges[2].Evaluate(x, y) + edges[2].bias;
+
+#if defined(__AVX2__)
+		__m256i outside = _mm256_or_si256(_mm256_or_si256(rows[0].Evaluate(start0), rows[1].Evaluate(start1)), rows[2].Evaluate(start2));
+		return ~(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+#else
+		__m128i s0 = _mm_set1_epi32(start0);
+		__m128i s1 = _mm_set1_epi32(start1);
+		__m128i s2 = _mm_set1_epi32(start2);
+
+		__m128i outside_lo = _mm_or_si128(_mm_or_si128(_mm_add_epi32(s0, rows[0].offsets_lo), _mm_add_epi32(s1, rows[1].offsets_lo)), _mm_add_epi32(s2, rows[2].offsets_lo));
+		__m128i outside_hi = _mm_or_si128(_mm_or_si128(_mm_add_epi32(s0, rows[0].offsets_hi), _mm_add_epi32(s1, rows[1].offsets_hi)), _mm_add_epi32(s2, rows[2].offsets_hi));
+
+		unsigned int outside = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(outside_lo)) | ((unsigned int)_mm_movemask_ps(_mm_castsi128_ps(outside_hi)) << 4);
+		return ~outside & 0xFF;
+#endif
+	}
+
+	inline unsigned int CoverageMask8(const EdgeFunction<SUBPIXEL_BITS> edges[3], const EdgeRow8Wide rows[3], int x, int y)
+	{
+		long long e0 = edges[0].Evaluate(x, y) + edges[0].bias;
+		long long e1 = edges[1].Evaluate(x, y) + edges[1].bias;
+		long long e2 = edges[2].Evaluate(x, y) + edges[2].bias;
+
+		unsigned int mask = 0;
+		for (int i = 0; i < BLOCK_SIZE; ++i)
+		{
+			mask |= (unsigned int)((e0 | e1 | e2) >= 0) << i;
+			e0 += rows[0].step;
+			e1 += rows[1].step;
+			e2 += rows[2].step;
+		}
+		return mask;
+	}
+}
+
+RasterizeKernel Rasterizer::HalfSpaceKernel(bool textured, bool deferred, bool subPixel)
+{
+	if (subPixel)
+		return SelectKernel(textured, deferred, []<typename C>() -> RasterizeKernel { return &RasterizeHalfSpace<C, SUBPIXEL_BITS>; });
+
+	return SelectKernel(textured, deferred, []<typename C>() -> RasterizeKernel { return &RasterizeHalfSpace<C, 0>; });
+}
+
+template <typename C, int S>
+void Rasterizer::RasterizeHalfSpace(const RasterTriangle& triangle, const TileRect& rect)
+{
+	using Int = typename EdgeFunction<S>::Int;
+
+	unsigned int index[3] = { triangle.v0, triangle.v1, triangle.v2 };
+
+	// Whole pixels snap like the scanline walker, sub-pixel positions to 1 / 2^S of a pixel
+	Int X[3], Y[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		X[i] = (Int)std::llround(m_Vertices[index[i]].x * (float)(1 << S));
+		Y[i] = (Int)std::llround(m_Vertices[index[i]].y * (float)(1 << S));
+	}
+
+	// Twice the signed area of the triangle
+	Int area = (Y[0] - Y[1]) * (X[2] - X[0]) + (X[1] - X[0]) * (Y[2] - Y[0]);
+	if (area == 0)
+		return;
+
+	if (area < 0)
+	{
+		std::swap(index[1], index[2]);
+		std::swap(X[1], X[2]);
+		std::swap(Y[1], Y[2]);
+		area = -area;
+	}
+
+	// Pixels of the bounds, the shift floors so negative positions stay outside
+	int min_x = std::max((int)(std::min({ X[0], X[1], X[2] }) >> S), rect.x0);
+	int min_y = std::max((int)(std::min({ Y[0], Y[1], Y[2] }) >> S), rect.y0);
+	int max_x = std::min((int)(std::max({ X[0], X[1], X[2] }) >> S), rect.x1 - 1);
+	int max_y = std::min((int)(std::max({ Y[0], Y[1], Y[2] }) >> S), rect.y1 - 1);
+
+	if (min_x > max_x || min_y > max_y)
+		return;
+
+	// Edge i is opposite to vertex i, so E_i / area is the barycentric weight of vertex i
+	const EdgeFunction<S> edges[3] = {
+		EdgeFunction<S>(X[1], Y[1], X[2], Y[2]),
+		EdgeFunction<S>(X[2], Y[2], X[0], Y[0]),
+		EdgeFunction<S>(X[0], Y[0], X[1], Y[1])
+	};
+
+	const EdgeRow<S> rows[3] = { EdgeRow<S>(edges[0]), EdgeRow<S>(edges[1]), EdgeRow<S>(edges[2]) };
+
+	const float invArea = 1.0f / (float)area;
+
+	// Position of the triangle in the visibility buffer
+	const unsigned int triangleId = (unsigned int)(&triangle - m_Triangles.data());
+
+	const cgl::vec4& p0 = m_Vertices[index[0]];
+	const cgl::vec4& p1 = m_Vertices[index[1]];
+	const cgl::vec4& p2 = m_Vertices[index[2]];
+
+	const auto c0 = load_varying<C::hasColor>(m_Colors[index[0]]);
+	const auto c1 = load_varying<C::hasColor>(m_Colors[index[1]]);
+	const auto c2 = load_varying<C::hasColor>(m_Colors[index[2]]);
+
+	const auto n0 = load_varying<C::hasNormal>(m_Normals[index[0]]);
+	const auto n1 = load_varying<C::hasNormal>(m_Normals[index[1]]);
+	const auto n2 = load_varying<C::hasNormal>(m_Normals[index[2]]);
+
+	const auto uv0 = load_varying<C::hasUV>(m_UVs[index[0]]);
+	const auto uv1 = load_varying<C::hasUV>(m_UVs[index[1]]);
+	const auto uv2 = load_varying<C::hasUV>(m_UVs[index[2]]);
+
+	// Barycentric step of one pixel to the right
+	const float dw0 = (float)edges[0].StepX() * invArea;
+	const float dw1 = (float)edges[1].StepX() * invArea;
+	const float dw2 = (float)edges[2].StepX() * invArea;
+
+	// Change of the UVs one pixel right and one pixel down, for the level of detail of each quad
+	const typename C::UV uv_ddx = uv0 * dw0 + uv1 * dw1 + uv2 * dw2;
+	const typename C::UV uv_ddy = (uv0 * (float)edges[0].StepY() + uv1 * (float)edges[1].StepY() + uv2 * (float)edges[2].StepY()) * invArea;
+
+	using Depth = typename C::Depth;
+
+	PipelineStatistics& stats = WorkerStatistics();
+
+	// Depth plane of the triangle, for the hierarchical z test of each block
+	// and the depth test of each row
+	const float min_z = std::min({ p0.z, p1.z, p2.z });
+	const float z_scale = std::max({ 1.0f, std::abs(p0.z), std::abs(p1.z), std::abs(p2.z) });
+	const float dzdx = dw0 * p0.z + dw1 * p1.z + dw2 * p2.z;
+	const float dzdy = ((float)edges[0].StepY() * p0.z + (float)edges[1].StepY() * p1.z + (float)edges[2].StepY() * p2.z) * invArea;
+
+	FragmentBatch<C> batch;
+
+	for (int by = min_y & ~(BLOCK_SIZE - 1); by <= max_y; by += BLOCK_SIZE)
+	{
+		for (int bx = min_x & ~(BLOCK_SIZE - 1); bx <= max_x; bx += BLOCK_SIZE)
+		{
+			// Classify the block with the corner that is most inside and the
+			// corner that is most outside of every edge
+			bool accept = true;
+			bool reject = false;
+
+			for (const auto& e : edges)
+			{
+				Int corner  = e.Evaluate(bx, by) + e.bias;
+				Int inside  = corner + (std::max(e.StepX(), Int(0)) + std::max(e.StepY(), Int(0))) * (BLOCK_SIZE - 1);
+				Int outside = corner + (std::min(e.StepX(), Int(0)) + std::min(e.StepY(), Int(0))) * (BLOCK_SIZE - 1);
+
+				reject |= inside < 0;
+				accept &= outside >= 0;
+			}
+
+			if (reject)
+				continue;
+
+			// Nearest depth of the triangle inside the block, with some slack for
+			// the rounding of the far away barycentrics of the corner
+			if (m_IsHiZEnabled)
+			{
+				float c0 = (float)edges[0].Evaluate(bx, by) * invArea;
+				float c1 = (float)edges[1].Evaluate(bx, by) * invArea;
+				float c2 = (float)edges[2].Evaluate(bx, by) * invArea;
+
+				float nearest = c0 * p0.z + c1 * p1.z + c2 * p2.z
+					+ (std::min(dzdx, 0.0f) + std::min(dzdy, 0.0f)) * (BLOCK_SIZE - 1);
+				nearest -= 1e-5f * (1.0f + std::abs(c0) + std::abs(c1) + std::abs(c2)) * z_scale;
+
+				if (std::max(nearest, min_z) >= m_HiZ.get(by / BLOCK_SIZE, bx / BLOCK_SIZE))
+					continue;
+			}
+
+			// Columns of the block inside the tile and the triangle bounds
+			int x_begin = std::max(bx, min_x);
+			int x_end   = std::min(bx + BLOCK_SIZE - 1, max_x);
+			int y_begin = std::max(by, min_y);
+			int y_end   = std::min(by + BLOCK_SIZE - 1, max_y);
+
+			unsigned int columns = ((1u << (x_end - x_begin + 1)) - 1) << (x_begin - bx);
+
+			// Rows go in pairs so pixels are shaded by 2x2 quads, blocks are aligned to
+			// 8 pixels so the quads are aligned to 2
+			for (int qy = y_begin & ~1; qy <= y_end; qy += 2)
+			{
+				unsigned int masks[2] = {};
+				float z_rows[2] = {};
+				std::byte* depthRows[2] = {};
+
+				for (int r = 0; r < 2; ++r)
+				{
+					const int y = qy + r;
+					if (y < y_begin || y > y_end)
+						continue;
+
+					unsigned int mask = columns & (accept ? 0xFFu : CoverageMask8(edges, rows, bx, y));
+					if (!mask)
+						continue;
+
+					// The 8 pixels of the row go through the depth test at once
+					z_rows[r] = ((float)edges[0].Evaluate(bx, y) * p0.z
+						+ (float)edges[1].Evaluate(bx, y) * p1.z
+						+ (float)edges[2].Evaluate(bx, y) * p2.z) * invArea;
+
+					depthRows[r] = m_DepthBuffer.row(y);
+					stats.fragmentsGenerated += std::popcount(mask);
+					mask &= DepthTest8<Depth>(depthRows[r], bx, z_rows[r], dzdx);
+
+					const unsigned int passes = std::popcount(mask);
+					stats.depthPasses += passes;
+					if constexpr (!C::deferred)
+					{
+						if constexpr (C::textured)
+							stats.texelsFetched[FilteringIndex(C::filtering)] += passes * TexelsPerFragment(C::filtering);
+						stats.pixelsWritten += passes;
+					}
+
+					masks[r] = mask;
+				}
+
+				// Bits 2q and 2q + 1 of both rows are quad q
+				unsigned int quads = masks[0] | masks[1];
+				while (quads)
+				{
+					const int q = std::countr_zero(quads) / 2;
+					quads &= ~(3u << (q * 2));
+
+					// Set by the first pixel of the quad, one log2 for the four
+					float lod = -1.0f;
+
+					for (int r = 0; r < 2; ++r)
+					{
+						unsigned int pixels = masks[r] & (3u << (q * 2));
+						const int y = qy + r;
+
+						while (pixels)
+						{
+							int x = bx + std::countr_zero(pixels);
+							pixels &= pixels - 1;
+
+							float w0 = (float)edges[0].Evaluate(x, y) * invArea;
+							float w1 = (float)edges[1].Evaluate(x, y) * invArea;
+							float w2 = (float)edges[2].Evaluate(x, y) * invArea;
+
+							float z = z_rows[r] + dzdx * (float)(x - bx);
+							CountOverdraw(x, y);
+
+							if constexpr (C::deferred)
+							{
+								// Weights of the triangle as submitted, not of the reordered vertices
+								float b1 = index[1] == triangle.v1 ? w1 : w2;
+								float b2 = index[1] == triangle.v1 ? w2 : w1;
+								m_VisibilityBuffer.set(m_VisibilityBuffer.height() - 1 - y, x, { triangleId, b1, b2 });
+							}
+							else
+							{
+								typename C::Color  pixelColorPC  = c0 * w0 + c1 * w1 + c2 * w2;
+								typename C::Normal pixelNormalPC = n0 * w0 + n1 * w1 + n2 * w2;
+								typename C::UV     pixelUVPC     = uv0 * w0 + uv1 * w1 + uv2 * w2;
+
+								if constexpr (C::hasLod)
+								{
+									if (lod < 0.0f)
+										lod = QuadLod<C>(pixelUVPC, uv_ddx, uv_ddy, triangle.texture);
+								}
+
+								batch.Add(x, y, pixelColorPC, pixelNormalPC, pixelUVPC, lod);
+								if (batch.IsFull())
+									ShadeBatch<C>(batch, triangle.texture);
+							}
+							Depth::Store(depthRows[r], x, Depth::Encode(z));
+
+							if (m_IsHiZEnabled)
+								MarkHiZ(x, y);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if constexpr (!C::deferred)
+	{
+		if (batch.count)
+			ShadeBatch<C>(batch, triangle.texture);
+	}
+}
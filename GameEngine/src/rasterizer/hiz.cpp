@@ -0,0 +1,94 @@
+#include "rasterizer.hpp"
+
+namespace
+{
+	// Largest depth key stored in [x0, x1) x [y0, y1)
+	template <typename D>
+	float FarthestKey(DepthBuffer& depthBuffer, int x0, int y0, int x1, int y1)
+	{
+		float farthest = std::numeric_limits<float>::lowest();
+		for (int y = y0; y < y1; ++y)
+		{
+			const std::byte* row = depthBuffer.row(y);
+			for (int x = x0; x < x1; ++x)
+				farthest = std::max(farthest, D::Decode(D::Load(row, x)));
+		}
+		return farthest;
+	}
+
+	float FarthestKey(DepthBuffer& depthBuffer, int x0, int y0, int x1, int y1)
+	{
+		switch (depthBuffer.format())
+		{
+		case DEPTH_FORMAT::FLOAT32_REVERSED: return FarthestKey<DepthFormat<DEPTH_FORMAT::FLOAT32_REVERSED>>(depthBuffer, x0, y0, x1, y1);
+		case DEPTH_FORMAT::UNORM24:          return FarthestKey<DepthFormat<DEPTH_FORMAT::UNORM24>>(depthBuffer, x0, y0, x1, y1);
+		case DEPTH_FORMAT::UNORM16:          return FarthestKey<DepthFormat<DEPTH_FORMAT::UNORM16>>(depthBuffer, x0, y0, x1, y1);
+		default:                             return FarthestKey<DepthFormat<DEPTH_FORMAT::FLOAT32>>(depthBuffer, x0, y0, x1, y1);
+		}
+	}
+}
+
+TileRect Rasterizer::HiZBlocks(const RasterTriangle& triangle, const TileRect& rect)
+{
+	const auto& p0 = m_Vertices[triangle.v0];
+	const auto& p1 = m_Vertices[triangle.v1];
+	const auto& p2 = m_Vertices[triangle.v2];
+
+	// Same conservative bounds as the binning, limited to the tile
+	int min_x = std::max((int)std::floor(std::min({ p0.x, p1.x, p2.x })) - 1, rect.x0);
+	int min_y = std::max((int)std::floor(std::min({ p0.y, p1.y, p2.y })) - 1, rect.y0);
+	int max_x = std::min((int)std::ceil (std::max({ p0.x, p1.x, p2.x })) + 1, rect.x1 - 1);
+	int max_y = std::min((int)std::ceil (std::max({ p0.y, p1.y, p2.y })) + 1, rect.y1 - 1);
+
+	if (min_x > max_x || min_y > max_y)
+		return { 0, 0, 0, 0 };
+
+	// Inclusive block range
+	return { min_x / HIZ_BLOCK_SIZE, min_y / HIZ_BLOCK_SIZE, max_x / HIZ_BLOCK_SIZE + 1, max_y / HIZ_BLOCK_SIZE + 1 };
+}
+
+bool Rasterizer::IsOccluded(const RasterTriangle& triangle, const TileRect& rect)
+{
+	if (!m_IsHiZEnabled)
+		return false;
+
+	float min_z = std::min({ m_Vertices[triangle.v0].z, m_Vertices[triangle.v1].z, m_Vertices[triangle.v2].z });
+
+	// Visible as soon as one block has something farther than the nearest point of the triangle
+	TileRect blocks = HiZBlocks(triangle, rect);
+	for (int by = blocks.y0; by < blocks.y1; ++by)
+	{
+		for (int bx = blocks.x0; bx < blocks.x1; ++bx)
+		{
+			if (min_z < m_HiZ.get(by, bx))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void Rasterizer::UpdateHiZ(const RasterTriangle& triangle, const TileRect& rect)
+{
+	if (!m_IsHiZEnabled)
+		return;
+
+	TileRect blocks = HiZBlocks(triangle, rect);
+	for (int by = blocks.y0; by < blocks.y1; ++by)
+	{
+		for (int bx = blocks.x0; bx < blocks.x1; ++bx)
+		{
+			if (!m_HiZDirty.get(by, bx))
+				continue;
+
+			int x_end = std::min((bx + 1) * HIZ_BLOCK_SIZE, (int)m_screenWidth);
+			int y_end = std::min((by + 1) * HIZ_BLOCK_SIZE, (int)m_screenHeight);
+
+			// Decoded, so the blocks hold depth keys for every format
+			float farthest = FarthestKey(m_DepthBuffer, bx * HIZ_BLOCK_SIZE, by * HIZ_BLOCK_SIZE, x_end, y_end);
+
+			m_HiZ.set(by, bx, farthest);
+			m_HiZDirty.set(by, bx, 0);
+		}
+	}
+}
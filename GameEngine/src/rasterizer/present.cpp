@@ -0,0 +1,113 @@
+#include "rasterizer.hpp"
+
+std::unique_ptr<Texture> Rasterizer::m_TextureToDrawOn;
+std::unique_ptr<ViewPort> Rasterizer::m_ViewportToDrawOn;
+std::unique_ptr<PixelBufferRing> Rasterizer::m_PixelBuffers;
+
+void Rasterizer::SetPixelBufferPresentation(bool enabled)
+{
+	m_IsPixelBufferPresentation = enabled && PixelBufferRing::IsSupported();
+}
+
+void Rasterizer::Present()
+{
+	PROFILE_SCOPE("Presentation");
+
+	// Before the render thread could draw a frame that does not fit
+	if (m_IsPixelBufferPresentation && (!m_PixelBuffers || m_PixelBuffers->GetCapacity() < m_SubmittedPixels))
+		ResizePixelBuffers(m_SubmittedPixels);
+
+	{
+		std::lock_guard lock(m_FrameMutex);
+		if (m_IsReady)
+		{
+			// Uploaded under the lock, the render thread only waits for it when it finishes another frame meanwhile
+			const auto start = std::chrono::steady_clock::now();
+			UploadReadyFrame();
+			m_UploadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			MarkPresented();
+		}
+	}
+
+	// Nothing finished yet
+	if (!m_TextureToDrawOn)
+		return;
+
+	if (!m_ViewportToDrawOn)
+		m_ViewportToDrawOn = std::make_unique<ViewPort>();
+
+	m_ViewportToDrawOn->OnRenderTexture(*m_TextureToDrawOn);
+}
+
+void Rasterizer::UploadReadyFrame()
+{
+	const unsigned int width = (unsigned int)m_ReadyBuffer.width();
+	const unsigned int height = (unsigned int)m_ReadyBuffer.height();
+	const int slot = m_PixelBuffers && m_TextureToDrawOn ? m_PixelBuffers->Find(m_ReadyBuffer.data()) : -1;
+
+	if (slot >= 0)
+	{
+		m_PixelBuffers->Upload(slot, *m_TextureToDrawOn, width, height);
+		m_UploadingSlots.push_back(slot);
+	}
+	else
+	{
+		const unsigned char* data = &m_ReadyBuffer.data()->r;
+		if (!m_TextureToDrawOn)
+			m_TextureToDrawOn = std::make_unique<Texture>(data, width, height, Texture::Filtering::NEAREST_NEIGHBOR);
+		else
+			m_TextureToDrawOn->Update(data, width, height);
+	}
+
+	if (!m_IsPixelBufferPresentation || !m_PixelBuffers)
+	{
+		// The slot may still be read by the upload
+		if (slot >= 0)
+			m_ReadyBuffer.Detach();
+		return;
+	}
+
+	// The render thread gets this buffer back on its next frame, it must not be read anymore.
+	// There are more slots than frame buffers, so one is always free or uploading
+	int next;
+	if (!m_FreeSlots.empty())
+	{
+		next = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		next = m_UploadingSlots.front();
+		m_UploadingSlots.pop_front();
+		m_PixelBuffers->Wait(next);
+	}
+
+	m_ReadyBuffer.SetStorage(reinterpret_cast<Pixel*>(m_PixelBuffers->Data(next)), m_PixelBuffers->GetCapacity(), height, width);
+}
+
+void Rasterizer::ResizePixelBuffers(size_t pixels)
+{
+	// Nothing draws into the old ring once the render thread is idle
+	WaitIdle();
+
+	std::lock_guard lock(m_FrameMutex);
+	m_FrameBuffer.Detach();
+	m_ReadyBuffer.Detach();
+
+	m_PixelBuffers.reset();
+	m_PixelBuffers = std::make_unique<PixelBufferRing>(std::max<size_t>(pixels, 1));
+	m_FreeSlots.clear();
+	m_UploadingSlots.clear();
+
+	// Frames go through plain texture updates from now on, instead of trying again every frame
+	if (!m_PixelBuffers->IsMapped())
+	{
+		std::cout << "ERROR\nPIXEL BUFFER PRESENTATION DISABLED\n";
+		m_PixelBuffers.reset();
+		m_IsPixelBufferPresentation = false;
+		return;
+	}
+
+	for (int slot = 0; slot < PixelBufferRing::SLOTS; ++slot)
+		m_FreeSlots.push_back(slot);
+}
@@ -1,22 +1,63 @@
 #include "rasterizer.hpp"
+#include "fragment.hpp"
+#include "HeapCounter.hpp"
 
-static Pixel to_pixel(const glm::vec3& c)
+void Rasterizer::SetViewPort(const unsigned int screenWidth, const unsigned int screenHeight)
 {
-	return { (unsigned char)(c.x * 255), (unsigned char)(c.y * 255), (unsigned char)(c.z * 255) };
+	m_FrameBuffer.resize(screenHeight, screenWidth);
+	m_DepthBuffer.resize(screenHeight, screenWidth);
+	m_HiZ.resize((screenHeight + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE, (screenWidth + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE);
+	m_HiZDirty.resize(m_HiZ.height(), m_HiZ.width());
+
+	// Only pixels written by a draw are shaded and reset, so it is cleared once per size
+	if (m_VisibilityBuffer.height() != screenHeight || m_VisibilityBuffer.width() != screenWidth)
+	{
+		m_VisibilityBuffer.resize(screenHeight, screenWidth);
+		m_VisibilityBuffer.clear({ VisibilitySample::EMPTY, 0.0f, 0.0f });
+	}
+
+	m_screenWidth = screenWidth;
+	m_screenHeight = screenHeight;
+
+	ResizeTiles();
 }
 
-static Pixel to_pixel(const cgl::vec3& c)
+void Rasterizer::SetTiledRendering(bool enabled, unsigned int threadCount, unsigned int tileSize)
 {
-	return { (unsigned char)(c.x * 255.0f), (unsigned char)(c.y * 255.0f), (unsigned char)(c.z * 255.0f) };
+	m_IsTiled = enabled;
+	m_ThreadCount = std::clamp(threadCount, 1u, GetMaxThreadCount());
+	// Whole hierarchical z blocks per tile, so threads never share a block
+	m_TileSize = (std::max(tileSize, (unsigned int)HIZ_BLOCK_SIZE) + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE * HIZ_BLOCK_SIZE;
+
+	ResizeTiles();
 }
 
-void Rasterizer::SetViewPort(const unsigned int screenWidth, const unsigned int screenHeight)
+void Rasterizer::ResizeTiles()
 {
-	m_FrameBuffer.resize(screenHeight, screenWidth);
-	m_ZBuffer.resize(screenHeight, screenWidth);
+	unsigned int tilesX = (m_screenWidth  + m_TileSize - 1) / m_TileSize;
+	unsigned int tilesY = (m_screenHeight + m_TileSize - 1) / m_TileSize;
 
-	m_screenWidth = screenWidth;
-	m_screenHeight = screenHeight;
+	if (tilesX == m_TilesX && tilesY == m_TilesY && !m_Tiles.empty()
+		&& m_Tiles[0].rect.x1 == (int)std::min(m_TileSize, m_screenWidth)
+		&& m_Tiles.back().rect.x1 == (int)m_screenWidth && m_Tiles.back().rect.y1 == (int)m_screenHeight)
+		return;
+
+	m_TilesX = tilesX;
+	m_TilesY = tilesY;
+	m_Tiles.resize(m_TilesX * m_TilesY);
+
+	for (unsigned int ty = 0; ty < m_TilesY; ++ty)
+	{
+		for (unsigned int tx = 0; tx < m_TilesX; ++tx)
+		{
+			Tile& tile = m_Tiles[ty * m_TilesX + tx];
+			tile.rect.x0 = tx * m_TileSize;
+			tile.rect.y0 = ty * m_TileSize;
+			tile.rect.x1 = std::min((tx + 1) * m_TileSize, m_screenWidth);
+			tile.rect.y1 = std::min((ty + 1) * m_TileSize, m_screenHeight);
+			tile.triangles = {};
+		}
+	}
 }
 
 void Rasterizer::ClearFrameBuffer()
@@ -26,13 +67,16 @@ void Rasterizer::ClearFrameBuffer()
 
 void Rasterizer::ClearZBuffer()
 {
-	m_ZBuffer.clear(std::numeric_limits<float>::max());
+	m_DepthBuffer.clear();
+	m_HiZ.clear(std::numeric_limits<float>::max());
+	m_HiZDirty.clear(0);
 }
 
 void Rasterizer::DrawSoftwareRasterized(
 	const Model& model,
+	const Transform& transform,
 	const cgl::Camera& camera,
-	DirectionalLight& DirectionalLight,
+	const DirectionalLight& DirectionalLight,
 	PRIMITIVE primitive,
 	SHADING shading,
 	bool showTextures,
@@ -47,11 +91,11 @@ void Rasterizer::DrawSoftwareRasterized(
 	m_Filtering = textureFiltering;
 
 	// Build Model Matrix
-	cgl::mat4 translate = cgl::mat4::translate(cgl::vec4(model.transform.position, 1.0f));
-	cgl::mat4 rotation = cgl::mat4::rotateX(model.transform.rotation.x);
-	rotation = rotation * cgl::mat4::rotateY(model.transform.rotation.y);
-	rotation = rotation * cgl::mat4::rotateZ(model.transform.rotation.z);
-	cgl::mat4 scale = cgl::mat4::scale(model.transform.scale);
+	cgl::mat4 translate = cgl::mat4::translate(cgl::vec4(transform.position, 1.0f));
+	cgl::mat4 rotation = cgl::mat4::rotateX(transform.rotation.x);
+	rotation = rotation * cgl::mat4::rotateY(transform.rotation.y);
+	rotation = rotation * cgl::mat4::rotateZ(transform.rotation.z);
+	cgl::mat4 scale = cgl::mat4::scale(transform.scale);
 	cgl::mat4 modelM = translate * rotation * scale;
 
 	// Build View Matrix
@@ -70,464 +114,592 @@ void Rasterizer::DrawSoftwareRasterized(
 
 	cgl::mat4 modelView_transposed_inversed = (modelM).inverse().transpose();
 
-	for (unsigned int i = 0; i < model.meshes.size(); ++i)
-	{
-		std::vector<cgl::vec4> cglVertices;
-		std::vector<cgl::vec4> cglColors;
-		std::vector<cgl::vec4> cglNormals;
-		std::vector<cgl::vec3> cglUVs;
+	PROFILE_SCOPE("Draw");
 
-		cglVertices.reserve(model.meshes[i].vertices.size());
-		cglColors.reserve(model.meshes[i].vertices.size());
-		cglNormals.reserve(model.meshes[i].vertices.size());
-		cglUVs.reserve(model.meshes[i].vertices.size());
+	const size_t heapAllocations = HeapCounter::Allocations();
+	m_DrawStatistics = {};
 
+	// Upper bound without clipping, so the streams are not regrown inside the arena
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	for (const auto& mesh : model.meshes)
+	{
+		vertexCount += mesh.vertices.size();
+		triangleCount += (mesh.indices.empty() ? mesh.vertices.size() : mesh.indices.size()) / 3;
+	}
+	ResetArena(vertexCount, triangleCount);
 
-		if (m_ShowTexture)
-			m_CurrentTexture = !model.meshes[i].textures.empty() ? model.meshes[i].textures[0] : nullptr;
+	// Planes taken from the mvp are in object space, same as the cached bounds
+	const Frustum frustum(mvp);
+	const bool isModelVisible = !m_IsFrustumCulling || frustum.Intersects(model.sphere, model.bounds);
 
-		for (unsigned int j = 0; j < model.meshes[i].vertices.size(); j += 3)
+	{
+		PROFILE_SCOPE("Vertex Stage");
+		for (const auto& mesh : model.meshes)
 		{
-			// ===============================
-			// Go To Homogeneus Clipping Space
-			// ===============================
+			// Before any vertex work
+			if (m_IsFrustumCulling && (!isModelVisible || !frustum.Intersects(mesh.sphere, mesh.bounds)))
+				continue;
 
-			// Vertex Transforms
-			cgl::vec4 v0 = mvp * cgl::vec4(model.meshes[i].vertices[j + 0].Position, 1.0f);
-			cgl::vec4 v1 = mvp * cgl::vec4(model.meshes[i].vertices[j + 1].Position, 1.0f);
-			cgl::vec4 v2 = mvp * cgl::vec4(model.meshes[i].vertices[j + 2].Position, 1.0f);
+			const Texture* texture = m_ShowTexture && !mesh.textures.empty() ? mesh.textures[0].get() : nullptr;
+			if (texture)
+				texture->BuildLevels();
 
-			// Clipping
-			if (!v0.is_in_range(v0.w) || !v1.is_in_range(v1.w) || !v2.is_in_range(v2.w))
-				continue;
+			// Every vertex of the mesh is processed once, triangles only reference them
+			unsigned int base = (unsigned int)m_Vertices.size();
+			ProcessVertices(mesh, mvp, viewport, modelView_transposed_inversed);
+			AssembleTriangles(mesh, base, texture, viewport, isCulling, isCullingClockWise);
+		}
+	}
 
-			// Culling
-			if (isCulling)
-			{
-				cgl::vec3 u = (v1 - v0).to_vec3();
-				cgl::vec3 v = (v2 - v0).to_vec3();
-				float sign = (u.x * v.y) - (v.x * u.y);
-				if (isCullingClockWise && sign > 0.0f)
-					continue;
-				if (!isCullingClockWise && sign < 0.0f)
-					continue;
-			}
+	SelectKernels();
 
-			// ===================================
-			// Go To Normalized Device Coordinates
-			// ===================================
-
-			// Save w for perspective correct interpolation
-			float v0w = v0.w;
-			float v1w = v1.w;
-			float v2w = v2.w;
-
-			// Perspective division of all coordinates (x,y,z,w)
-			v0 /= v0.w;
-			v1 /= v1.w;
-			v2 /= v2.w;
-
-			// =======================
-			// Go To Pixel Coordinates
-			// =======================
-
-			v0 = viewport * v0;
-			v1 = viewport * v1;
-			v2 = viewport * v2;
-
-			// Save w for perspective correct interpolation
-			v0.w = v0w;
-			v1.w = v1w;
-			v2.w = v2w;
-
-			cglVertices.push_back(v0);
-			cglVertices.push_back(v1);
-			cglVertices.push_back(v2);
-
-			// ==============
-			// Get Attributes
-			// ==============
-
-			// =================================
-			// Perspective Correct Interpolation
-			// =================================
-			
-			// UVs
-			auto uv0 = cgl::vec3(model.meshes[i].vertices[j + 0].TexCoord.x, model.meshes[i].vertices[j + 0].TexCoord.y, 1.0f);
-			auto uv1 = cgl::vec3(model.meshes[i].vertices[j + 1].TexCoord.x, model.meshes[i].vertices[j + 1].TexCoord.y, 1.0f);
-			auto uv2 = cgl::vec3(model.meshes[i].vertices[j + 2].TexCoord.x, model.meshes[i].vertices[j + 2].TexCoord.y, 1.0f);
-
-			auto uvPerspectiveCorrect0 = uv0 * (1 / v0.w);
-			auto uvPerspectiveCorrect1 = uv1 * (1 / v1.w);
-			auto uvPerspectiveCorrect2 = uv2 * (1 / v2.w);
-
-			cglUVs.push_back(uvPerspectiveCorrect0);
-			cglUVs.push_back(uvPerspectiveCorrect1);
-			cglUVs.push_back(uvPerspectiveCorrect2);
-
-			// Normals
-			auto normal0 = modelView_transposed_inversed * cgl::vec4(model.meshes[i].vertices[j + 0].Normal, 1);
-			auto normal1 = modelView_transposed_inversed * cgl::vec4(model.meshes[i].vertices[j + 1].Normal, 1);
-			auto normal2 = modelView_transposed_inversed * cgl::vec4(model.meshes[i].vertices[j + 2].Normal, 1);
-
-			auto normalPerspectiveCorrect0 = normal0 * (1 / v0.w);
-			auto normalPerspectiveCorrect1 = normal1 * (1 / v1.w);
-			auto normalPerspectiveCorrect2 = normal2 * (1 / v2.w);
-
-			cglNormals.push_back(normalPerspectiveCorrect0);
-			cglNormals.push_back(normalPerspectiveCorrect1);
-			cglNormals.push_back(normalPerspectiveCorrect2);
-
-			// Colors
-			auto color0 = cgl::vec4(model.meshes[i].vertices[j + 0].Color, 1);
-			auto color1 = cgl::vec4(model.meshes[i].vertices[j + 1].Color, 1);
-			auto color2 = cgl::vec4(model.meshes[i].vertices[j + 2].Color, 1);
-
-			if (shading == SHADING::GOURAUD)
-			{
-				auto dirLight = cgl::vec3(-m_DirectionalLight.direction).normalized();
+	size_t workerAllocations = 0;
 
-				// vertex 0
-				{
-					auto diff = std::max(0.0f, dirLight.dot(normal0.to_vec3()));
-					auto diffuse = m_DirectionalLight.diffuse * color0.to_vec3() * diff;
-					auto ambient = m_DirectionalLight.ambient * color0.to_vec3();
-					color0 = cgl::vec4(ambient + diffuse, 1.0f);
-				}
+	timer_fragment_shader.reset_soft();
+	if (m_IsTiled || m_IsCapturing)
+	{
+		BinTriangles();
+		workerAllocations = RasterizeTiles();
+	}
+	else
+	{
+		TileRect screen{ 0, 0, (int)m_screenWidth, (int)m_screenHeight };
+		{
+			PROFILE_SCOPE("Raster");
+			for (const auto& triangle : m_Triangles)
+				RasterizeTriangle(triangle, screen);
+		}
 
-				// vertex 1
-				{
-					auto diff = std::max(0.0f, dirLight.dot(normal1.to_vec3()));
-					auto diffuse = m_DirectionalLight.diffuse * color1.to_vec3() * diff;
-					auto ambient = m_DirectionalLight.ambient * color1.to_vec3();
-					color1 = cgl::vec4(ambient + diffuse, 1.0f);
-				}
+		if (m_IsDeferred && m_Primitive == PRIMITIVE::Triangle)
+		{
+			PROFILE_SCOPE("Shading");
+			ShadeVisibilityBuffer(screen);
+		}
+	}
+	timer_fragment_shader.stop();
 
-				// vertex 2
-				{
-					auto diff = std::max(0.0f, dirLight.dot(normal2.to_vec3()));
-					auto diffuse = m_DirectionalLight.diffuse * color2.to_vec3() * diff;
-					auto ambient = m_DirectionalLight.ambient * color2.to_vec3();
-					color2 = cgl::vec4(ambient + diffuse, 1.0f);
-				}
-			}
+	m_HeapAllocations = HeapCounter::Allocations() - heapAllocations + workerAllocations;
+
+	FinishDrawStatistics();
+}
 
-			auto colorPerspectiveCorrect0 = color0 * (1 / v0.w);
-			auto colorPerspectiveCorrect1 = color1 * (1 / v1.w);
-			auto colorPerspectiveCorrect2 = color2 * (1 / v2.w);
+void Rasterizer::FinishDrawStatistics()
+{
+	m_DrawStatistics.trianglesRasterized = m_Triangles.size();
 
-			cglColors.push_back(colorPerspectiveCorrect0);
-			cglColors.push_back(colorPerspectiveCorrect1);
-			cglColors.push_back(colorPerspectiveCorrect2);
-		}
-		timer_fragment_shader.reset_soft();
-		Rasterize(cglVertices, cglColors, cglNormals, cglUVs);
-		timer_fragment_shader.stop();
+	for (auto& worker : m_ThreadStatistics)
+	{
+		m_DrawStatistics += worker;
+		worker = {};
 	}
 
-	if (!m_TextureToDrawOn)
-		m_TextureToDrawOn = std::make_unique<Texture>(&m_FrameBuffer.data()->r, m_screenWidth, m_screenHeight, Texture::Filtering::NEAREST_NEIGHBOR);
-	else
-		m_TextureToDrawOn->Update(&m_FrameBuffer.data()->r, m_screenWidth, m_screenHeight);
+	// Every generated fragment was either tested in or out
+	m_DrawStatistics.depthFails = m_DrawStatistics.fragmentsGenerated - m_DrawStatistics.depthPasses;
 
-	if (!m_ViewportToDrawOn)
-		m_ViewportToDrawOn = std::make_unique<ViewPort>();
+	m_FrameDraws.push_back(m_DrawStatistics);
+}
 
-	m_ViewportToDrawOn->OnRenderTexture(*m_TextureToDrawOn);
+void Rasterizer::ResetArena(size_t vertexCount, size_t triangleCount)
+{
+	// Fresh containers, the old ones still point into the arena
+	m_Vertices  = ArenaVector<cgl::vec4>(&m_Arena);
+	m_Colors    = ArenaVector<cgl::vec4>(&m_Arena);
+	m_Normals   = ArenaVector<cgl::vec4>(&m_Arena);
+	m_UVs       = ArenaVector<cgl::vec3>(&m_Arena);
+	m_Triangles = ArenaVector<RasterTriangle>(&m_Arena);
+
+	for (auto& tile : m_Tiles)
+		tile.triangles = {};
+
+	m_Arena.Reset();
+
+	m_Vertices.reserve(vertexCount);
+	m_Colors.reserve(vertexCount);
+	m_Normals.reserve(vertexCount);
+	m_UVs.reserve(vertexCount);
+	m_Triangles.reserve(triangleCount);
 }
 
-void Rasterizer::Rasterize(
-	std::vector<cgl::vec4>& pixelCoordinates, 
-	std::vector<cgl::vec4>& pixelColors, 
-	std::vector<cgl::vec4>& pixelNormals,
-	std::vector<cgl::vec3>& pixelUVs)
+void Rasterizer::ProcessVertices(const Mesh& mesh, const cgl::mat4& mvp, const cgl::mat4& viewport, const cgl::mat4& normalMatrix)
 {
-	for (unsigned int i = 0; i < pixelCoordinates.size(); i += 3)
+	// Positions go to clipping space and to pixel coordinates in one pass,
+	// normals are transformed in the same batched way
+	cgl::transform_points(mvp, viewport, mesh.positions, m_ClipStream, m_ScreenStream);
+	cgl::transform_vectors(normalMatrix, mesh.normals, 1.0f, m_NormalStream);
+	m_DrawStatistics.verticesIn += mesh.vertices.size();
+
+	const auto dirLight = cgl::vec3(-m_DirectionalLight.direction).normalized();
+
+	for (size_t i = 0; i < mesh.vertices.size(); ++i)
 	{
-		auto& p0 = pixelCoordinates[i + 0];
-		auto& p1 = pixelCoordinates[i + 1];
-		auto& p2 = pixelCoordinates[i + 2];
-
-		unsigned int first  = i + 0;
-		unsigned int second = i + 1;
-		unsigned int third  = i + 2;
-
-		auto x0 = (unsigned int)std::round(p0.x);
-		auto y0 = (unsigned int)std::round(p0.y);
-		auto x1 = (unsigned int)std::round(p1.x);
-		auto y1 = (unsigned int)std::round(p1.y);
-		auto x2 = (unsigned int)std::round(p2.x);
-		auto y2 = (unsigned int)std::round(p2.y);
-
-		// Ordena de forma decrescente em Y (top to bottom)
-		if (std::tie(y1, x1) < std::tie(y0, x0)) { std::swap(x0, x1); std::swap(y0, y1); std::swap(p0, p1); std::swap(first, second);}
-		if (std::tie(y2, x2) < std::tie(y0, x0)) { std::swap(x0, x2); std::swap(y0, y2); std::swap(p0, p2); std::swap(first, third); }
-		if (std::tie(y2, x2) < std::tie(y1, x1)) { std::swap(x1, x2); std::swap(y1, y2); std::swap(p1, p2); std::swap(second, third);}
-
-		auto& c0 = pixelColors[first];
-		auto& c1 = pixelColors[second];
-		auto& c2 = pixelColors[third];
-
-		auto& n0 = pixelNormals[first];
-		auto& n1 = pixelNormals[second];
-		auto& n2 = pixelNormals[third];
-
-		auto& uv0 = pixelUVs[first];
-		auto& uv1 = pixelUVs[second];
-		auto& uv2 = pixelUVs[third];
-
-		// triangulo no tem rea. Pois y1 j est abaixo de y0, ento se y0 == y2, eles esto todos juntos
-		/*if (y0 == y2)
-			return;*/
-
-		// Determina se o lado menor est na esquerda ou direita
-		// verdadeiro = direito
-		// falso = esquerdo
-		bool shortside = (y1 - y0) * (x2 - x0) < (x1 - x0) * (y2 - y0);
-
-		// Criamos 2 retas: p0-p1 (menor) e p0-p2(maior)
-		std::array<std::unique_ptr<Slope<float>>, 2> slope_x;
-		std::array<std::unique_ptr<Slope<float>>, 2> slope_z;
-
-		std::array<std::unique_ptr<Slope<cgl::vec4>>, 2> slope_color;
-		std::array<std::unique_ptr<Slope<cgl::vec4>>, 2> slope_normal;
-		std::array<std::unique_ptr<Slope<cgl::vec3>>, 2> slope_uv;
-
-		int n_steps_longside = p2.y - p0.y;
-
-		slope_x[!shortside] = std::make_unique<Slope<float>>(p0.x, p2.x, n_steps_longside);
-		slope_z[!shortside] = std::make_unique<Slope<float>>(p0.z, p2.z, n_steps_longside);
-
-		slope_color[!shortside]  = std::make_unique<Slope<cgl::vec4>>(c0, c2, n_steps_longside);
-		slope_normal[!shortside] = std::make_unique<Slope<cgl::vec4>>(n0, n2, n_steps_longside);
-		slope_uv[!shortside]     = std::make_unique<Slope<cgl::vec3>>(uv0, uv2, n_steps_longside);
-
-		// ====================
-		// Main Rasterizer Loop
-		// ====================
-
-		// Check if not y0 == y1
-		if (y0 < y1)
-		{
-			// Calcula a segunda reta para o lado menor
-			int n_steps = p1.y - p0.y;
+		const auto& vertex = mesh.vertices[i];
 
-			slope_x[shortside] = std::make_unique<Slope<float>>(p0.x, p1.x, n_steps);
-			slope_z[shortside] = std::make_unique<Slope<float>>(p0.z, p1.z, n_steps);
+		// Pixel coordinates, w was kept for perspective correct interpolation
+		float w = m_ScreenStream.w[i];
+		cgl::vec4 position = m_ScreenStream.get(i);
+		position.z = DepthKey(position);
+		m_Vertices.push_back(position);
 
-			slope_color[shortside]  = std::make_unique<Slope<cgl::vec4>>(c0,  c1,  n_steps );
-			slope_normal[shortside] = std::make_unique<Slope<cgl::vec4>>(n0,  n1,  n_steps);
-			slope_uv[shortside]     = std::make_unique<Slope<cgl::vec3>>(uv0, uv1, n_steps);
+		// ==============
+		// Get Attributes
+		// ==============
 
-			for (auto y = y0; y < y1; ++y)
-			{
-				Scanline(y,
-					std::round(slope_x[0]->get()), std::round(slope_x[1]->get()),
-					slope_z[0]->get(), slope_z[1]->get(),
-					slope_color[0]->get(), slope_color[1]->get(),
-					slope_normal[0]->get(), slope_normal[1]->get(),
-					slope_uv[0]->get(), slope_uv[1]->get());
-
-				slope_x[0]->advance();
-				slope_x[1]->advance();
-				slope_z[0]->advance();
-				slope_z[1]->advance();
-
-				slope_color[0]->advance();
-				slope_color[1]->advance();
-
-				slope_normal[0]->advance();
-				slope_normal[1]->advance();
-
-				slope_uv[0]->advance();
-				slope_uv[1]->advance();
-			}
+		auto normal = m_NormalStream.get(i);
+		auto color = cgl::vec4(vertex.Color, 1);
+
+		if (m_Shading == SHADING::GOURAUD)
+		{
+			auto diff = std::max(0.0f, dirLight.dot(normal.to_vec3()));
+			auto diffuse = m_DirectionalLight.diffuse * color.to_vec3() * diff;
+			auto ambient = m_DirectionalLight.ambient * color.to_vec3();
+			color = cgl::vec4(ambient + diffuse, 1.0f);
 		}
 
-		// Check if not y1 == y2
-		if (y1 < y2)
+		// =================================
+		// Perspective Correct Interpolation
+		// =================================
+
+		auto uv = cgl::vec3(vertex.TexCoord.x, vertex.TexCoord.y, 1.0f);
+
+		m_UVs.push_back(uv * (1 / w));
+		m_Normals.push_back(normal * (1 / w));
+		m_Colors.push_back(color * (1 / w));
+	}
+}
+
+TileRect Rasterizer::TileBounds(const RasterTriangle& triangle)
+{
+	const auto& p0 = m_Vertices[triangle.v0];
+	const auto& p1 = m_Vertices[triangle.v1];
+	const auto& p2 = m_Vertices[triangle.v2];
+
+	// Conservative bounds, one pixel of margin for the rounding done while rasterizing
+	int min_x = (int)std::floor(std::min({ p0.x, p1.x, p2.x })) - 1;
+	int min_y = (int)std::floor(std::min({ p0.y, p1.y, p2.y })) - 1;
+	int max_x = (int)std::ceil (std::max({ p0.x, p1.x, p2.x })) + 1;
+	int max_y = (int)std::ceil (std::max({ p0.y, p1.y, p2.y })) + 1;
+
+	return {
+		std::clamp(min_x / (int)m_TileSize, 0, (int)m_TilesX - 1),
+		std::clamp(min_y / (int)m_TileSize, 0, (int)m_TilesY - 1),
+		std::clamp(max_x / (int)m_TileSize, 0, (int)m_TilesX - 1) + 1,
+		std::clamp(max_y / (int)m_TileSize, 0, (int)m_TilesY - 1) + 1
+	};
+}
+
+void Rasterizer::BinTriangles()
+{
+	PROFILE_SCOPE("Binning");
+
+	// Two passes over the triangles: count the triangles of every tile, then
+	// fill one arena array where each tile owns a contiguous range
+	unsigned int* counts = m_Arena.Allocate<unsigned int>(m_Tiles.size());
+	std::fill_n(counts, m_Tiles.size(), 0u);
+
+	for (const auto& triangle : m_Triangles)
+	{
+		TileRect tiles = TileBounds(triangle);
+		for (int ty = tiles.y0; ty < tiles.y1; ++ty)
+			for (int tx = tiles.x0; tx < tiles.x1; ++tx)
+				++counts[ty * m_TilesX + tx];
+	}
+
+	size_t total = 0;
+	for (size_t t = 0; t < m_Tiles.size(); ++t)
+		total += counts[t];
+
+	unsigned int* bins = m_Arena.Allocate<unsigned int>(total);
+
+	// counts becomes the write position of every tile
+	size_t offset = 0;
+	for (size_t t = 0; t < m_Tiles.size(); ++t)
+	{
+		m_Tiles[t].triangles = { bins + offset, counts[t] };
+		counts[t] = (unsigned int)offset;
+		offset += m_Tiles[t].triangles.size();
+	}
+
+	// Triangles are appended in submission order, so every tile sees its
+	// triangles in the same order as the single threaded path
+	for (unsigned int i = 0; i < m_Triangles.size(); ++i)
+	{
+		TileRect tiles = TileBounds(m_Triangles[i]);
+		for (int ty = tiles.y0; ty < tiles.y1; ++ty)
+			for (int tx = tiles.x0; tx < tiles.x1; ++tx)
+				bins[counts[ty * m_TilesX + tx]++] = i;
+	}
+}
+
+size_t Rasterizer::RasterizeTiles()
+{
+	const int tileCount = (int)m_Tiles.size();
+
+	// Heap allocations are counted per thread, the calling thread runs tiles too
+	// and its own ones are already counted with the rest of the draw
+	const size_t callerAllocations = HeapCounter::Allocations();
+	size_t allocations = 0;
+
+	// Each tile owns its region of color and depth, so tiles can run in any order
+	#pragma omp parallel num_threads(m_ThreadCount) reduction(+ : allocations)
+	{
+		// One zone per worker and draw, shading included. Zones per tile would fill
+		// the profiler rings within a few frames at high resolutions
+		PROFILE_SCOPE("Raster");
+
+		#pragma omp for schedule(dynamic, 1)
+		for (int t = 0; t < tileCount; ++t)
 		{
-			// Calcula a terceira reta
-			int n_steps = p2.y - p1.y;
+			const size_t tileAllocations = HeapCounter::Allocations();
 
-			slope_x[shortside] = std::make_unique<Slope<float>>(p1.x, p2.x, n_steps);
-			slope_z[shortside] = std::make_unique<Slope<float>>(p1.z, p2.z, n_steps);
+			const auto start = m_IsCapturing ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
 
-			slope_color[shortside]  = std::make_unique<Slope<cgl::vec4>>(c1,  c2,  n_steps);
-			slope_normal[shortside] = std::make_unique<Slope<cgl::vec4>>(n1,  n2,  n_steps);
-			slope_uv[shortside]     = std::make_unique<Slope<cgl::vec3>>(uv1, uv2, n_steps);
+			const Tile& tile = m_Tiles[t];
+			for (unsigned int i : tile.triangles)
+				RasterizeTriangle(m_Triangles[i], tile.rect);
 
-			for (auto y = y1; y < y2; ++y)
-			{
-				Scanline(y,
-					std::round(slope_x[0]->get()), std::round(slope_x[1]->get()),
-					slope_z[0]->get(),      slope_z[1]->get(),
-					slope_color[0]->get(),  slope_color[1]->get(),
-					slope_normal[0]->get(), slope_normal[1]->get(),
-					slope_uv[0]->get(),     slope_uv[1]->get());
-
-				slope_x[0]->advance();
-				slope_x[1]->advance();
-				slope_z[0]->advance();
-				slope_z[1]->advance();
-
-				slope_color[0]->advance();
-				slope_color[1]->advance();
-
-				slope_normal[0]->advance();
-				slope_normal[1]->advance();
-
-				slope_uv[0]->advance();
-				slope_uv[1]->advance();
-			}
+			// The tile is done, its pixels can be shaded by the same thread
+			if (m_IsDeferred && m_Primitive == PRIMITIVE::Triangle)
+				ShadeVisibilityBuffer(tile.rect);
+
+			if (m_IsCapturing)
+				m_TileCost[t] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			allocations += HeapCounter::Allocations() - tileAllocations;
 		}
 	}
+
+	return allocations - (HeapCounter::Allocations() - callerAllocations);
 }
 
-void Rasterizer::Scanline(
-	unsigned int y, 
-	int x_left, int x_right,
-	float z_left, float z_right,
-	cgl::vec4 color_left, cgl::vec4 color_right, 
-	cgl::vec4 normal_left, cgl::vec4 normal_right,
-	cgl::vec3 uv_left, cgl::vec3 uv_right)
+void Rasterizer::RasterizeTriangle(const RasterTriangle& triangle, const TileRect& rect)
 {
-	// TODO: why????
-	if (x_right < x_left)
+	if (IsOccluded(triangle, rect))
+		return;
+
+	// The blocks the triangle can write to get the clear color first
+	TileRect blocks = HiZBlocks(triangle, rect);
+	m_FrameBuffer.Touch(blocks.x0, blocks.y0, blocks.x1, blocks.y1);
+
+	m_RasterizeKernels[triangle.texture != nullptr](triangle, rect);
+
+	UpdateHiZ(triangle, rect);
+}
+
+void Rasterizer::SelectKernels()
+{
+	const bool isDeferred = m_IsDeferred && m_Primitive == PRIMITIVE::Triangle;
+
+	// Points and wireframe only touch the edges, the scanline walker already gives them
+	const bool isHalfSpace = m_Traversal != TRAVERSAL::SCANLINE && m_Primitive == PRIMITIVE::Triangle;
+	const bool isSubPixel = m_Traversal == TRAVERSAL::HALF_SPACE_SUBPIXEL;
+
+	for (bool textured : { false, true })
 	{
-		std::swap(x_right, x_left);
-		std::swap(z_right, z_left);
-		std::swap(color_right, color_left);
-		std::swap(normal_right, normal_left);
-		std::swap(uv_left, uv_right);
+		m_RasterizeKernels[textured] = isHalfSpace ? HalfSpaceKernel(textured, isDeferred, isSubPixel) : ScanlineKernel(textured, isDeferred);
+		m_ShadeKernels[textured] = VisibilityKernel(textured);
 	}
+}
 
-	Slope<float> z_buf     (z_left, z_right,           x_right - x_left);
-	Slope<cgl::vec4> color (color_left, color_right,   x_right - x_left);
-	Slope<cgl::vec4> normal(normal_left, normal_right, x_right - x_left);
-	Slope<cgl::vec3> uv    (uv_left, uv_right,         x_right - x_left);
+RasterizeKernel Rasterizer::ScanlineKernel(bool textured, bool deferred)
+{
+	return SelectKernel(textured, deferred, []<typename C>() -> RasterizeKernel { return &Rasterize<C>; });
+}
 
-	if (m_Primitive == PRIMITIVE::Triangle)
+template <typename C>
+void Rasterizer::Rasterize(const RasterTriangle& triangle, const TileRect& rect)
+{
+	// Copies: the same triangle is rasterized by every tile it touches
+	cgl::vec4 p0 = m_Vertices[triangle.v0];
+	cgl::vec4 p1 = m_Vertices[triangle.v1];
+	cgl::vec4 p2 = m_Vertices[triangle.v2];
+
+	unsigned int first  = triangle.v0;
+	unsigned int second = triangle.v1;
+	unsigned int third  = triangle.v2;
+
+	// Barycentric weights of each vertex, follow them through the sorting
+	auto b0 = load_varying<C::hasBary>(cgl::vec3(1.0f, 0.0f, 0.0f));
+	auto b1 = load_varying<C::hasBary>(cgl::vec3(0.0f, 1.0f, 0.0f));
+	auto b2 = load_varying<C::hasBary>(cgl::vec3(0.0f, 0.0f, 1.0f));
+
+	// Position of the triangle in the visibility buffer
+	unsigned int triangleId = (unsigned int)(&triangle - m_Triangles.data());
+
+	// Signed, vertices inside the guard band may be outside of the screen
+	auto x0 = (int)std::round(p0.x);
+	auto y0 = (int)std::round(p0.y);
+	auto x1 = (int)std::round(p1.x);
+	auto y1 = (int)std::round(p1.y);
+	auto x2 = (int)std::round(p2.x);
+	auto y2 = (int)std::round(p2.y);
+
+	// Ordena de forma decrescente em Y (top to bottom)
+	if (std::tie(y1, x1) < std::tie(y0, x0)) { std::swap(x0, x1); std::swap(y0, y1); std::swap(p0, p1); std::swap(first, second); std::swap(b0, b1); }
+	if (std::tie(y2, x2) < std::tie(y0, x0)) { std::swap(x0, x2); std::swap(y0, y2); std::swap(p0, p2); std::swap(first, third);  std::swap(b0, b2); }
+	if (std::tie(y2, x2) < std::tie(y1, x1)) { std::swap(x1, x2); std::swap(y1, y2); std::swap(p1, p2); std::swap(second, third); std::swap(b1, b2); }
+
+	const auto c0 = load_varying<C::hasColor>(m_Colors[first]);
+	const auto c1 = load_varying<C::hasColor>(m_Colors[second]);
+	const auto c2 = load_varying<C::hasColor>(m_Colors[third]);
+
+	const auto n0 = load_varying<C::hasNormal>(m_Normals[first]);
+	const auto n1 = load_varying<C::hasNormal>(m_Normals[second]);
+	const auto n2 = load_varying<C::hasNormal>(m_Normals[third]);
+
+	const auto uv0 = load_varying<C::hasUV>(m_UVs[first]);
+	const auto uv1 = load_varying<C::hasUV>(m_UVs[second]);
+	const auto uv2 = load_varying<C::hasUV>(m_UVs[third]);
+
+	// Change of the UVs one pixel right and one pixel down, the same over the whole triangle
+	typename C::UV uv_ddx{};
+	typename C::UV uv_ddy{};
+	if constexpr (C::hasLod)
 	{
-		for (int x = x_left; x < x_right; ++x)
-		{
-			if (z_buf.get() < m_ZBuffer.get(m_ZBuffer.height() - 1 - y, x))
-			{
-				cgl::vec3 pixelColor  = (color.get()  * (1 / color.get().w)).to_vec3();
-				cgl::vec3 pixelNormal = (normal.get() * (1 / normal.get().w)).to_vec3().normalized();
-				cgl::vec2 pixelUV     = (uv.get()     * (1 / uv.get().z)).to_vec2();
+		cgl::vec3 stepX, stepY;
+		BarycentricSteps(p0, p1, p2, stepX, stepY);
+		uv_ddx = uv0 * stepX.x + uv1 * stepX.y + uv2 * stepX.z;
+		uv_ddy = uv0 * stepY.x + uv1 * stepY.y + uv2 * stepY.z;
+	}
 
+	// triangulo no tem rea. Pois y1 j est abaixo de y0, ento se y0 == y2, eles esto todos juntos
+	/*if (y0 == y2)
+		return;*/
 
-				if (m_ShowTexture && m_CurrentTexture)
-				{
-					const unsigned char* const textureBuffer = m_CurrentTexture->GetLocalBuffer();
-					pixelColor = { 0.0f,0.0f,0.0f };
+	// Determina se o lado menor est na esquerda ou direita
+	// verdadeiro = direito
+	// falso = esquerdo
+	bool shortside = (y1 - y0) * (x2 - x0) < (x1 - x0) * (y2 - y0);
 
-					if (m_Filtering == Texture::Filtering::NEAREST_NEIGHBOR)
-					{
-						unsigned int u = std::floor(std::clamp(pixelUV.x, 0.0f, 1.0f) * (float)(m_CurrentTexture->GetWidth()  - 1.0f));
-						unsigned int v = std::floor(std::clamp(pixelUV.y, 0.0f, 1.0f) * (float)(m_CurrentTexture->GetHeight() - 1.0f));
+	// Criamos 2 retas: p0-p1 (menor) e p0-p2(maior)
+	// On the stack, the short side is only reassigned between the two halves
+	std::array<Slope<float>, 2> slope_x;
+	std::array<Slope<float>, 2> slope_z;
 
-						pixelColor = Texture::GetPixelColorFromTextureBuffer(textureBuffer, m_CurrentTexture->GetWidth(), u, v);
-					}
+	std::array<Slope<typename C::Color>, 2>  slope_color;
+	std::array<Slope<typename C::Normal>, 2> slope_normal;
+	std::array<Slope<typename C::UV>, 2>     slope_uv;
+	std::array<Slope<typename C::Bary>, 2>   slope_bary;
 
-					else if (m_Filtering == Texture::Filtering::BILINEAR)
-					{
-						float u = std::clamp(pixelUV.x, 0.0f, 1.0f) * (float)(m_CurrentTexture->GetWidth()  - 1.0f);
-						float v = std::clamp(pixelUV.y, 0.0f, 1.0f) * (float)(m_CurrentTexture->GetHeight() - 1.0f);
+	int n_steps_longside = p2.y - p0.y;
 
-						pixelColor = Texture::BilinearFiltering(textureBuffer, m_CurrentTexture->GetWidth(), u, v);
-					}
+	slope_x[!shortside] = Slope<float>(p0.x, p2.x, n_steps_longside);
+	slope_z[!shortside] = Slope<float>(p0.z, p2.z, n_steps_longside);
 
-					else if (m_Filtering == Texture::Filtering::BICUBIC)
-					{
-						float u = std::clamp(pixelUV.x, 0.0f, 1.0f) * (float)(m_CurrentTexture->GetWidth() - 1.0f);
-						float v = std::clamp(pixelUV.y, 0.0f, 1.0f) * (float)(m_CurrentTexture->GetHeight() - 1.0f);
+	slope_color[!shortside]  = Slope<typename C::Color>(c0, c2, n_steps_longside);
+	slope_normal[!shortside] = Slope<typename C::Normal>(n0, n2, n_steps_longside);
+	slope_uv[!shortside]     = Slope<typename C::UV>(uv0, uv2, n_steps_longside);
+	slope_bary[!shortside]   = Slope<typename C::Bary>(b0, b2, n_steps_longside);
 
-						pixelColor = Texture::BicubicFiltering(textureBuffer, m_CurrentTexture->GetWidth(), m_CurrentTexture->GetHeight(), u, v);
-					}
+	// ====================
+	// Main Rasterizer Loop
+	// ====================
 
-					else if (m_Filtering == Texture::Filtering::TRILLINEAR)
-					{
-						float u = std::clamp(pixelUV.x, 0.0f, 1.0f);
-						float v = std::clamp(pixelUV.y, 0.0f, 1.0f);
+	// Check if not y0 == y1
+	if (y0 < y1)
+	{
+		// Calcula a segunda reta para o lado menor
+		int n_steps = p1.y - p0.y;
 
-						auto st = uv;
-						st.advance();
-						auto pixelST = (st.get() * (1 / st.get().z)).to_vec2();
+		slope_x[shortside] = Slope<float>(p0.x, p1.x, n_steps);
+		slope_z[shortside] = Slope<float>(p0.z, p1.z, n_steps);
 
-						float next_s = std::clamp(pixelST.x, 0.0f, 1.0f);
-						float next_t = std::clamp(pixelST.y, 0.0f, 1.0f);
+		slope_color[shortside]  = Slope<typename C::Color>(c0,  c1,  n_steps );
+		slope_normal[shortside] = Slope<typename C::Normal>(n0,  n1,  n_steps);
+		slope_uv[shortside]     = Slope<typename C::UV>(uv0, uv1, n_steps);
+		slope_bary[shortside]   = Slope<typename C::Bary>(b0, b1, n_steps);
 
-						auto ds = (next_s - u) * m_CurrentTexture->GetWidth();
-						auto dt = (next_t - v) * m_CurrentTexture->GetHeight();
+		int y_begin = std::max(y0, rect.y0);
+		int y_end   = std::min(y1, rect.y1);
 
-						float mipmap_level = std::abs(MipMap::GetMipMapLevel(ds, dt));
-						mipmap_level = std::clamp(mipmap_level, 0.0f, 6.0f);
+		for (int y = y_begin; y < y_end; ++y)
+		{
+			// Both sides start at y0
+			int n = y - y0;
+
+			Scanline<C>(y,
+				std::round(slope_x[0].at(n)), std::round(slope_x[1].at(n)),
+				slope_z[0].at(n), slope_z[1].at(n),
+				slope_color[0].at(n), slope_color[1].at(n),
+				slope_normal[0].at(n), slope_normal[1].at(n),
+				slope_uv[0].at(n), slope_uv[1].at(n),
+				slope_bary[0].at(n), slope_bary[1].at(n),
+				uv_ddx, uv_ddy,
+				rect, triangleId);
+		}
+	}
 
-						const auto mipmap = m_CurrentTexture->GetMipMap();
+	// Check if not y1 == y2
+	if (y1 < y2)
+	{
+		// Calcula a terceira reta
+		int n_steps = p2.y - p1.y;
 
-						unsigned char* mipmaps_levels[2];
+		slope_x[shortside] = Slope<float>(p1.x, p2.x, n_steps);
+		slope_z[shortside] = Slope<float>(p1.z, p2.z, n_steps);
 
-						float t = (mipmap_level - std::floor(mipmap_level));
+		slope_color[shortside]  = Slope<typename C::Color>(c1,  c2,  n_steps);
+		slope_normal[shortside] = Slope<typename C::Normal>(n1,  n2,  n_steps);
+		slope_uv[shortside]     = Slope<typename C::UV>(uv1, uv2, n_steps);
+		slope_bary[shortside]   = Slope<typename C::Bary>(b1, b2, n_steps);
 
-						auto level_0 = std::floor(mipmap_level);
-						auto level_1 = std::ceil(mipmap_level);
+		int y_begin = std::max(y1, rect.y0);
+		int y_end   = std::min(y2, rect.y1);
 
-						float width_0 = m_CurrentTexture->GetWidth() / (std::pow(2,level_0));
-						float width_1 = m_CurrentTexture->GetWidth() / (std::pow(2,level_1));
+		for (int y = y_begin; y < y_end; ++y)
+		{
+			// The long side keeps going from y0, the short side restarts at y1
+			std::array<int, 2> n;
+			n[!shortside] = y - y0;
+			n[shortside]  = y - y1;
+
+			Scanline<C>(y,
+				std::round(slope_x[0].at(n[0])),      std::round(slope_x[1].at(n[1])),
+				slope_z[0].at(n[0]),      slope_z[1].at(n[1]),
+				slope_color[0].at(n[0]),  slope_color[1].at(n[1]),
+				slope_normal[0].at(n[0]), slope_normal[1].at(n[1]),
+				slope_uv[0].at(n[0]),     slope_uv[1].at(n[1]),
+				slope_bary[0].at(n[0]),   slope_bary[1].at(n[1]),
+				uv_ddx, uv_ddy,
+				rect, triangleId);
+		}
+	}
+}
 
-						float height_0 = m_CurrentTexture->GetHeight() / (std::pow(2, level_0));
-						float height_1 = m_CurrentTexture->GetHeight() / (std::pow(2, level_1));
+template <typename C>
+void Rasterizer::Scanline(
+	unsigned int y, 
+	int x_left, int x_right,
+	float z_left, float z_right,
+	typename C::Color color_left, typename C::Color color_right, 
+	typename C::Normal normal_left, typename C::Normal normal_right,
+	typename C::UV uv_left, typename C::UV uv_right,
+	typename C::Bary bary_left, typename C::Bary bary_right,
+	const typename C::UV& uv_ddx, const typename C::UV& uv_ddy,
+	const TileRect& rect,
+	unsigned int triangleId)
+{
+	// TODO: why????
+	if (x_right < x_left)
+	{
+		std::swap(x_right, x_left);
+		std::swap(z_right, z_left);
+		std::swap(color_right, color_left);
+		std::swap(normal_right, normal_left);
+		std::swap(uv_left, uv_right);
+		std::swap(bary_left, bary_right);
+	}
 
-						mipmaps_levels[0] = mipmap->GetLevel(level_0);
-						mipmaps_levels[1] = mipmap->GetLevel(level_1);
+	Slope<float>              z_buf (z_left, z_right,           x_right - x_left);
+	Slope<typename C::Color>  color (color_left, color_right,   x_right - x_left);
+	Slope<typename C::Normal> normal(normal_left, normal_right, x_right - x_left);
+	Slope<typename C::UV>     uv    (uv_left, uv_right,         x_right - x_left);
+	Slope<typename C::Bary>   bary  (bary_left, bary_right,     x_right - x_left);
 
-						auto color0 = Texture::BilinearFiltering(mipmaps_levels[0], width_0, u * width_0, v * height_0);
-						auto color1 = Texture::BilinearFiltering(mipmaps_levels[1], width_1, u * width_1, v * height_1);
+	using Depth = typename C::Depth;
+	std::byte* depthRow = m_DepthBuffer.row(y);
 
-						pixelColor = (1.0f - t) * color0 + (t) * color1;
-					}
-				}
+	PipelineStatistics& stats = WorkerStatistics();
+
+	if constexpr (C::primitive == PRIMITIVE::Triangle)
+	{
+		int x_begin = std::max(x_left, rect.x0);
+		int x_end   = std::min(x_right, rect.x1);
+
+		// Mip level of the 2x2 quad of the pixel, a span only walks one row of the
+		// quad so its two pixels on this row share it
+		int lodQuad = -1;
+		float lod = 0.0f;
+
+		FragmentBatch<C> batch;
+
+		for (int x = x_begin; x < x_end; ++x)
+		{
+			int i = x - x_left;
+
+			// Skip the part of the span inside a hierarchical z block that is already closer,
+			// z is linear along the span so its nearest value is at one of the ends
+			if (m_IsHiZEnabled && (x == x_begin || x % HIZ_BLOCK_SIZE == 0))
+			{
+				int block_end = std::min(x_end, (x / HIZ_BLOCK_SIZE + 1) * HIZ_BLOCK_SIZE);
+				float block_z = std::min(z_buf.at(i), z_buf.at(block_end - 1 - x_left));
 
-				if (m_Shading == SHADING::PHONG)
+				if (block_z >= m_HiZ.get(y / HIZ_BLOCK_SIZE, x / HIZ_BLOCK_SIZE))
 				{
-					auto dirLight = cgl::vec3(-m_DirectionalLight.direction).normalized();
-					auto diff = std::max(0.0f, dirLight.dot(pixelNormal));
-					auto diffuse = m_DirectionalLight.diffuse * pixelColor * diff;
+					x = block_end - 1;
+					continue;
+				}
+			}
+
+			auto depth = Depth::Encode(z_buf.at(i));
+			++stats.fragmentsGenerated;
 
-					auto ambient = m_DirectionalLight.ambient * pixelColor;
+			if (Depth::Passes(depth, Depth::Load(depthRow, x)))
+			{
+				++stats.depthPasses;
+				CountOverdraw(x, y);
 
-					pixelColor = ambient + diffuse;
+				if constexpr (C::deferred)
+				{
+					cgl::vec3 b = bary.at(i);
+					m_VisibilityBuffer.set(m_VisibilityBuffer.height() - 1 - y, x, { triangleId, b.y, b.z });
 				}
+				else
+				{
+					typename C::Color  pixelColorPC  = color.at(i);
+					typename C::Normal pixelNormalPC = normal.at(i);
+					typename C::UV     pixelUVPC     = uv.at(i);
+
+					if constexpr (C::hasLod)
+					{
+						if (x / 2 != lodQuad)
+						{
+							lodQuad = x / 2;
+							lod = QuadLod<C>(pixelUVPC, uv_ddx, uv_ddy, m_Triangles[triangleId].texture);
+						}
+					}
 
-				// else if (m_Shading == SHADING::NONE)
+					batch.Add(x, y, pixelColorPC, pixelNormalPC, pixelUVPC, lod);
+					if (batch.IsFull())
+						ShadeBatch<C>(batch, m_Triangles[triangleId].texture);
 
-				m_FrameBuffer.set(m_FrameBuffer.height() - 1 - y, x, to_pixel(pixelColor));
-				m_ZBuffer.set(m_ZBuffer.height() - 1 - y, x, z_buf.get());
+					if constexpr (C::textured)
+						stats.texelsFetched[FilteringIndex(C::filtering)] += TexelsPerFragment(C::filtering);
+					++stats.pixelsWritten;
+				}
+				Depth::Store(depthRow, x, depth);
 
-				z_buf.advance();
-				color.advance();
-				normal.advance();
-				uv.advance();
+				if (m_IsHiZEnabled)
+					MarkHiZ(x, y);
 			}
 		}
-	}
 
-	else if (m_Primitive == PRIMITIVE::WireFrame)
-	{
-		if (z_buf.get() < m_ZBuffer.get(m_ZBuffer.height() - 1 - y, x_left))
-			m_FrameBuffer.set(m_FrameBuffer.height() - 1 - y, x_left, to_pixel(color_left.to_vec3()));
-		if (z_buf.get() < m_ZBuffer.get(m_ZBuffer.height() - 1 - y, x_right))
-			m_FrameBuffer.set(m_FrameBuffer.height() - 1 - y, x_right, to_pixel(color_right.to_vec3()));
+		if constexpr (!C::deferred)
+		{
+			if (batch.count)
+				ShadeBatch<C>(batch, m_Triangles[triangleId].texture);
+		}
 	}
 
-	else if (m_Primitive == PRIMITIVE::Point)
+	// Both ends of the span, the same for points and wireframe
+	else
 	{
-		if (z_buf.get() < m_ZBuffer.get(m_ZBuffer.height() - 1 - y, x_left))
-			m_FrameBuffer.set(m_FrameBuffer.height() - 1 - y, x_left, to_pixel(color_left.to_vec3()));
-		if (z_buf.get() < m_ZBuffer.get(m_ZBuffer.height() - 1 - y, x_right))
-			m_FrameBuffer.set(m_FrameBuffer.height() - 1 - y, x_right, to_pixel(color_right.to_vec3()));
+		auto plot = [&](int x, float z, const typename C::Color& c)
+		{
+			if (x < rect.x0 || x >= rect.x1)
+				return;
+
+			++stats.fragmentsGenerated;
+			if (Depth::Passes(Depth::Encode(z), Depth::Load(depthRow, x)))
+			{
+				m_FrameBuffer.set(y, x, to_pixel(c.to_vec3()));
+				CountOverdraw(x, y);
+				++stats.depthPasses;
+				++stats.pixelsWritten;
+			}
+		};
+
+		plot(x_left, z_left, color_left);
+		plot(x_right, z_right, color_right);
 	}
 }
-
@@ -3,6 +3,15 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <array>
+#include <span>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
 
 #include "mesh.h"
 #include "mat.hpp"
@@ -15,106 +24,680 @@
 #include "light.h"
 #include "Lines.hpp"
 #include "Timer.hpp"
+#include "Profiler.hpp"
+#include "bounds.h"
+#include "arena.hpp"
+#include "depth.hpp"
+#include "framebuffer.hpp"
+#include "PixelBuffer.h"
 
 
-struct Pixel
+// How a filled triangle is walked to find its pixels
+enum class TRAVERSAL
 {
-	union
-	{
-		struct
-		{
-			unsigned char r, g, b;
-		};
-		unsigned char p[3];
-	};
+	// Top to bottom spans between the two active edges
+	SCANLINE,
+	// Integer edge functions over 8x8 blocks, trivially accepting or rejecting whole blocks
+	HALF_SPACE,
+	// Same, with vertices snapped to 1/256 of a pixel and pixels sampled at their center
+	HALF_SPACE_SUBPIXEL
 };
 
-inline std::ostream& operator << (std::ostream& out, const Pixel& p)
-{
-	return out << (unsigned int)p.r << ','
-		<< (unsigned int)p.g << ','
-		<< (unsigned int)p.b;
-}
-
 template <typename _T>
 struct Slope
 {
+	_T start;
 	_T curr;
 	_T step;
 
+	Slope() = default;
+
 	// starting position + distance between start & end * how far we have traveled / how far we are going to travel
 	// x_start + (x_end - x_start) * [(y - y_start) / (y_end - y_start)]
 	// the multiplication gives the t value (percentage traveled)
 	// For this Y where is the X?
 	Slope(_T begin, _T end, int n_steps)
 	{
-		float inv_steps = 1.0f / (float)n_steps;
+		float inv_steps = n_steps != 0 ? 1.0f / (float)n_steps : 0.0f;
 		step = (end - begin) * inv_steps;
 		curr = begin;
+		start = begin;
 	}
 
 	_T get() const { return curr; }
 	void advance() { curr += step; }
+
+	// Value after n steps, evaluated from the start so it does not depend on
+	// how many steps were skipped before (tiles start in the middle of spans)
+	_T at(int n) const { return start + step * (float)n; }
+};
+
+// Stands in for a varying a kernel does not use, every operation on it is a no-op
+struct Unused
+{
+	Unused operator + (Unused) const { return {}; }
+	Unused operator - (Unused) const { return {}; }
+	Unused operator * (float) const { return {}; }
+	Unused& operator += (Unused) { return *this; }
+};
+
+template <bool USED, typename _T>
+using Varying = std::conditional_t<USED, _T, Unused>;
+
+// Reads a varying only when the kernel uses it
+template <bool USED, typename _T>
+inline Varying<USED, _T> load_varying(const _T& v)
+{
+	if constexpr (USED)
+		return v;
+	else
+		return {};
+}
+
+constexpr size_t FILTERING_COUNT = 4;
+
+// Position of the filter in per filter arrays
+constexpr size_t FilteringIndex(Texture::Filtering filtering)
+{
+	switch (filtering)
+	{
+	case Texture::Filtering::NEAREST_NEIGHBOR: return 0;
+	case Texture::Filtering::BILINEAR:         return 1;
+	case Texture::Filtering::BICUBIC:          return 2;
+	default:                                   return 3;
+	}
+}
+
+// Texels the filter reads to shade one fragment
+constexpr unsigned int TexelsPerFragment(Texture::Filtering filtering)
+{
+	switch (filtering)
+	{
+	case Texture::Filtering::NEAREST_NEIGHBOR: return 1;
+	case Texture::Filtering::BILINEAR:         return 4;
+	case Texture::Filtering::BICUBIC:          return 16;
+	// Bilinear on two mip levels
+	default:                                   return 8;
+	}
+}
+
+// Work done by each stage, like the GL pipeline statistics queries
+struct PipelineStatistics
+{
+	uint64_t verticesIn = 0;
+	// Sent to the clipper for crossing the near or far plane or leaving the guard band
+	uint64_t trianglesClipped = 0;
+	uint64_t trianglesCulled = 0;
+	// Set up for rasterization, after culling and clipping
+	uint64_t trianglesRasterized = 0;
+	// Covered pixels that reached the depth test, the ones in blocks rejected
+	// by the hierarchical z buffer never do
+	uint64_t fragmentsGenerated = 0;
+	uint64_t depthPasses = 0;
+	uint64_t depthFails = 0;
+	// Indexed by FilteringIndex
+	std::array<uint64_t, FILTERING_COUNT> texelsFetched{};
+	uint64_t pixelsWritten = 0;
+
+	PipelineStatistics& operator += (const PipelineStatistics& other)
+	{
+		verticesIn += other.verticesIn;
+		trianglesClipped += other.trianglesClipped;
+		trianglesCulled += other.trianglesCulled;
+		trianglesRasterized += other.trianglesRasterized;
+		fragmentsGenerated += other.fragmentsGenerated;
+		depthPasses += other.depthPasses;
+		depthFails += other.depthFails;
+		for (size_t i = 0; i < FILTERING_COUNT; ++i)
+			texelsFetched[i] += other.texelsFetched[i];
+		pixelsWritten += other.pixelsWritten;
+		return *this;
+	}
+};
+
+// Everything a rasterization kernel does per fragment, fixed at compile time
+// so each kernel only interpolates the varyings it uses
+template <DEPTH_FORMAT Z, PRIMITIVE P, SHADING S, Texture::Filtering F, bool TEXTURED, bool DEFERRED>
+struct KernelConfig
+{
+	using Depth = DepthFormat<Z>;
+
+	static constexpr PRIMITIVE primitive = P;
+	static constexpr SHADING shading = S;
+	static constexpr Texture::Filtering filtering = F;
+	static constexpr bool textured = TEXTURED;
+	// Writes the visibility buffer instead of shading
+	static constexpr bool deferred = DEFERRED;
+
+	// Textures replace the vertex colors, points and wireframe only use them
+	static constexpr bool hasColor  = !DEFERRED && (P != PRIMITIVE::Triangle || !TEXTURED);
+	static constexpr bool hasNormal = !DEFERRED && P == PRIMITIVE::Triangle && S == SHADING::PHONG;
+	static constexpr bool hasUV     = !DEFERRED && P == PRIMITIVE::Triangle && TEXTURED;
+	static constexpr bool hasBary   = DEFERRED;
+	// Trilinear filtering picks its mip level once per 2x2 quad of pixels
+	static constexpr bool hasLod    = hasUV && F == Texture::Filtering::TRILLINEAR;
+
+	using Color  = Varying<hasColor,  cgl::vec4>;
+	using Normal = Varying<hasNormal, cgl::vec4>;
+	using UV     = Varying<hasUV,     cgl::vec3>;
+	using Bary   = Varying<hasBary,   cgl::vec3>;
+};
+
+// Fragments of one triangle waiting for their fragment stage, shaded together so
+// their texels are filtered 4 at a time. Attributes are still divided by w
+template <typename C>
+struct FragmentBatch
+{
+	static constexpr int SIZE = 4;
+
+	int count = 0;
+	int x[SIZE], y[SIZE];
+	typename C::Color color[SIZE];
+	typename C::Normal normal[SIZE];
+	typename C::UV uv[SIZE];
+	// Mip level of the quad of each fragment, only read by trilinear filtering
+	float lod[SIZE];
+
+	bool IsFull() const { return count == SIZE; }
+
+	void Add(int px, int py, const typename C::Color& c, const typename C::Normal& n, const typename C::UV& t, float l)
+	{
+		x[count] = px;
+		y[count] = py;
+		color[count] = c;
+		normal[count] = n;
+		uv[count] = t;
+		lod[count] = l;
+		++count;
+	}
+};
+
+struct RasterTriangle
+{
+	// Indices into the post-transform vertex streams
+	unsigned int v0, v1, v2;
+	const Texture* texture;
+};
+
+// Screen region in pixel coordinates, [x0, x1) x [y0, y1)
+struct TileRect
+{
+	int x0, y0;
+	int x1, y1;
+};
+
+// Visibility buffer entry, what is closest at a pixel and where inside of it
+struct VisibilitySample
+{
+	static constexpr unsigned int EMPTY = 0xFFFFFFFF;
+
+	// Index into the triangles of the current draw
+	unsigned int triangle;
+	// Screen space barycentric weights of the second and third vertices
+	float b1, b2;
+};
+
+// Pixels of one triangle inside a 2x2 quad of the visibility buffer
+struct VisibilityQuad
+{
+	int count = 0;
+	int x[4], y[4];
+	float b1[4], b2[4];
+};
+
+using RasterizeKernel = void (*)(const RasterTriangle& triangle, const TileRect& rect);
+// Shades the pixels of a quad covered by the triangle given the steps of the
+// barycentrics one pixel right and one pixel down, the quad shares one mip level
+using ShadeKernel = void (*)(const RasterTriangle& triangle, const VisibilityQuad& quad, const cgl::vec3& stepX, const cgl::vec3& stepY);
+
+// Side of the square pixel blocks of the hierarchical z buffer
+constexpr int HIZ_BLOCK_SIZE = 8;
+
+// Frame buffer blocks are cleared lazily with the same bounds as the hierarchical z ones
+static_assert(FrameBuffer::BLOCK_SIZE == HIZ_BLOCK_SIZE);
+
+struct Tile
+{
+	TileRect rect;
+	// Indices into the triangles of the current draw, stored in the frame arena
+	std::span<const unsigned int> triangles;
+};
+
+// False color views of a captured frame, drawn over it
+enum class HEATMAP
+{
+	NONE,
+	// Fragments that passed the depth test at each pixel
+	OVERDRAW,
+	// Time spent rasterizing and shading each tile, relative to the slowest one
+	TILE_COST
+};
+
+// Settings and draws of one frame of the software renderer. The scene records
+// it so the frame can be rendered away from the thread that owns the scene
+struct RasterizerFrame
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	Pixel clearColor{ 255, 255, 255, 255 };
+
+	bool isTiled = false;
+	unsigned int threadCount = 1;
+	unsigned int tileSize = 64;
+	TRAVERSAL traversal = TRAVERSAL::SCANLINE;
+	bool isHiZ = true;
+	bool isFrustumCulling = true;
+	bool isDeferred = false;
+	DEPTH_FORMAT depthFormat = DEPTH_FORMAT::FLOAT32;
+
+	// Debug capture of the overdraw of every pixel and the cost of every tile.
+	// Frames are rasterized tile by tile while capturing, even when not tiled.
+	// The capture is written to capturePath_overdraw.raw and capturePath_tiles.raw
+	// when the path is not empty
+	HEATMAP heatmap = HEATMAP::NONE;
+	std::string capturePath;
+
+	cgl::Camera camera;
+	DirectionalLight light;
+	PRIMITIVE primitive = PRIMITIVE::Triangle;
+	SHADING shading = SHADING::NONE;
+	bool showTextures = false;
+	bool isCulling = false;
+	bool isCullingClockWise = false;
+	Texture::Filtering filtering = Texture::Filtering::NEAREST_NEIGHBOR;
+
+	// Meshes are only read, the transform is copied since the UI edits it
+	struct Draw
+	{
+		const Model* model;
+		Transform transform;
+	};
+	std::vector<Draw> draws;
+};
+
+// Measurements of a rendered frame, handed to the main thread with its pixels
+struct RasterizerStats
+{
+	double texturingTime = 0.0;
+	size_t heapAllocations = 0;
+	size_t arenaUsage = 0;
+	// Whole RenderFrame, on whichever thread rendered it
+	double renderTime = 0.0;
+	// Totals of the frame and of each of its draws, in submission order
+	PipelineStatistics pipeline;
+	std::vector<PipelineStatistics> draws;
 };
 
 class Rasterizer 
 {
 public:
-	static void DrawSoftwareRasterized(
-		const Model& model,
-		const cgl::Camera& camera,
-		DirectionalLight& DirectionalLight,
-		PRIMITIVE primitive = PRIMITIVE::Triangle,
-		SHADING shading = SHADING::NONE,
-		bool showTextures = false,
-		bool isCulling = false,
-		bool isCullingClockWise = false,
-		Texture::Filtering textureFiltering = Texture::Filtering::NEAREST_NEIGHBOR
-	);
+	// Renders the frame on the calling thread, or queues it for the render thread
+	// when rendering is asynchronous. The setters below are applied from the frame
+	static void SubmitFrame(RasterizerFrame frame);
+	// Shows the newest finished frame, from the thread that owns the GL context
+	static void Present();
+	// Same without GL, the newest finished frame is returned instead of shown. It is
+	// nullptr when no frame finished since the last call, and only valid until the next one does
+	static const FrameBuffer* TakeFrame();
+
+	// The render thread works on the submitted frames while the main thread keeps
+	// presenting the last finished one. At most queueDepth frames wait for it, a
+	// new frame replaces the oldest one waiting
+	static void SetAsync(bool enabled, unsigned int queueDepth);
+	// Blocks until every submitted frame was rendered, models they draw must live until then
+	static void WaitIdle();
+
+	// Frames are rasterized straight into a ring of persistently mapped pixel
+	// buffers the texture is uploaded from, instead of being copied by the upload
+	static void SetPixelBufferPresentation(bool enabled);
+	static bool IsPixelBufferPresentation() { return m_IsPixelBufferPresentation; }
+
+	// Seconds between the submission of the presented frame and its presentation
+	static double GetFrameLatency() { return m_FrameLatency; }
+	// Frames submitted after the presented one
+	static uint64_t GetFramesInFlight() { return m_SubmittedFrames - m_PresentedFrame; }
+	static uint64_t GetDroppedFrames() { return m_DroppedFrames; }
+	// Grows by one or more whenever Present shows a new frame
+	static uint64_t GetPresentedFrame() { return m_PresentedFrame; }
 
 	static void SetViewPort(const unsigned int screenWidth, const unsigned int screenHeight);
 	static void ClearFrameBuffer();
 	static void SetClearColor(const Pixel& p) { m_ClearColor = p; };
 	static void ClearZBuffer();
-	static cgl::mat<Pixel>* GetFrameBuffer() { return &m_FrameBuffer; };
+	static FrameBuffer* GetFrameBuffer() { return &m_FrameBuffer; };
+
+	// Sort-middle mode: triangles are binned into tileSize x tileSize screen tiles
+	// and each worker thread rasterizes whole tiles, so no two threads share a pixel
+	static void SetTiledRendering(bool enabled, unsigned int threadCount, unsigned int tileSize);
+	static unsigned int GetMaxThreadCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+	static void SetTraversal(TRAVERSAL traversal) { m_Traversal = traversal; }
 
-	static double GetTexturingTime() { return timer_fragment_shader.duration(); };
+	// Skips models and meshes whose bounds are outside of the view volume
+	static void SetFrustumCulling(bool enabled) { m_IsFrustumCulling = enabled; }
+
+	// Rejects triangles and blocks hidden behind the farthest depth of each z buffer block
+	static void SetHiZ(bool enabled) { m_IsHiZEnabled = enabled; }
+
+	// Rasterization only stores depth, triangle and barycentrics, every
+	// covered pixel is shaded once at the end of the draw
+	static void SetDeferredShading(bool enabled) { m_IsDeferred = enabled; }
+
+	static void SetDepthFormat(DEPTH_FORMAT format) { m_DepthBuffer.SetFormat(format); }
+
+	// Measured on the presented frame
+	static double GetTexturingTime() { return m_Stats.texturingTime; };
+	static double GetRenderTime() { return m_Stats.renderTime; }
+	// Seconds the last Present spent handing the new frame to the texture
+	static double GetUploadTime() { return m_UploadTime; }
+
+	// Heap allocations made by the last draw between the start of the vertex
+	// stage and the end of rasterization, zero once the frame arena is warm.
+	// Only the drawing thread and its tile workers are counted, not the main
+	// thread running ImGui meanwhile
+	static size_t GetHeapAllocations() { return m_Stats.heapAllocations; }
+	static size_t GetArenaUsage() { return m_Stats.arenaUsage; }
+
+	// Always counted, measured on the presented frame
+	static const PipelineStatistics& GetPipelineStatistics() { return m_Stats.pipeline; }
+	static const std::vector<PipelineStatistics>& GetDrawStatistics() { return m_Stats.draws; }
 
 private:
 	Rasterizer();
 	Rasterizer(const Rasterizer&);
 
-	static void Rasterize(
-		std::vector<cgl::vec4>& pixelCoordinates, 
-		std::vector<cgl::vec4>& pixelColors, 
-		std::vector<cgl::vec4>& pixelNormals,
-		std::vector<cgl::vec3>& pixelUVs);
+	struct PendingFrame
+	{
+		RasterizerFrame frame;
+		uint64_t id = 0;
+		std::chrono::steady_clock::time_point submitted;
+	};
 
+	// Applies the settings of the frame and draws it into m_FrameBuffer
+	static void RenderFrame(const RasterizerFrame& frame);
+	// Swaps the finished m_FrameBuffer with the one read by Present()
+	static void PublishFrame(uint64_t id, std::chrono::steady_clock::time_point submitted);
+	static void RenderThread();
+	// Bookkeeping of the ready frame becoming the presented one, the lock is held
+	static void MarkPresented();
+	// Replaces the ring by one holding frames of pixels, the frame buffers leave the old one
+	static void ResizePixelBuffers(size_t pixels);
+	// Uploads the ready frame and moves it to a free slot, the lock is held
+	static void UploadReadyFrame();
+
+	static void DrawSoftwareRasterized(
+		const Model& model,
+		const Transform& transform,
+		const cgl::Camera& camera,
+		const DirectionalLight& DirectionalLight,
+		PRIMITIVE primitive,
+		SHADING shading,
+		bool showTextures,
+		bool isCulling,
+		bool isCullingClockWise,
+		Texture::Filtering textureFiltering
+	);
+
+	// Depth of a vertex in pixel coordinates as compared by the depth buffer,
+	// linear in screen space and smaller when nearer
+	static float DepthKey(const cgl::vec4& screen)
+	{
+		return m_DepthBuffer.format() == DEPTH_FORMAT::FLOAT32_REVERSED ? -1.0f / screen.w : screen.z * 0.5f + 0.5f;
+	}
+
+	// Transforms, lights and prepares every vertex of the mesh once for the current draw
+	static void ProcessVertices(const Mesh& mesh, const cgl::mat4& mvp, const cgl::mat4& viewport, const cgl::mat4& normalMatrix);
+	// Builds the triangles of the mesh from its index buffer, vertices start at base
+	static void AssembleTriangles(const Mesh& mesh, unsigned int base, const Texture* texture, const cgl::mat4& viewport, bool isCulling, bool isCullingClockWise);
+	// Clips a triangle against the planes in clipCodes and appends the resulting triangle fan
+	static void ClipTriangle(const unsigned int index[3], const cgl::vec4 clip[3], unsigned int clipCodes, const Texture* texture, const cgl::mat4& viewport);
+
+	// Picks the kernels of the current draw once, instead of branching per fragment
+	static void SelectKernels();
+	static RasterizeKernel ScanlineKernel(bool textured, bool deferred);
+	static RasterizeKernel HalfSpaceKernel(bool textured, bool deferred, bool subPixel);
+	static ShadeKernel VisibilityKernel(bool textured);
+
+	// Calls kernel.operator()<Config>() with the configuration of the current draw
+	template <typename _F>
+	static auto SelectKernel(bool textured, bool deferred, _F&& kernel);
+	template <DEPTH_FORMAT Z, typename _F>
+	static auto SelectKernel(bool textured, bool deferred, _F&& kernel);
+	// Same, limited to the configurations that shade filled triangles
+	template <DEPTH_FORMAT Z, typename _F>
+	static auto SelectShading(bool textured, _F&& kernel);
+	template <DEPTH_FORMAT Z, SHADING S, typename _F>
+	static auto SelectFiltering(bool textured, _F&& kernel);
+
+	static void RasterizeTriangle(const RasterTriangle& triangle, const TileRect& rect);
+
+	// Counters of the calling worker thread
+	static PipelineStatistics& WorkerStatistics();
+	// Adds the counters of the worker threads to the draw and appends it to the frame
+	static void FinishDrawStatistics();
+
+	template <typename C>
+	static void Rasterize(const RasterTriangle& triangle, const TileRect& rect);
+	// S fractional bits of vertex position
+	template <typename C, int S>
+	static void RasterizeHalfSpace(const RasterTriangle& triangle, const TileRect& rect);
+
+	template <typename C>
 	static void Scanline(unsigned int y, 
 		int left_x, int right_x,
 		float left_z, float right_z,
-		cgl::vec4 color_left, cgl::vec4 color_right,
-		cgl::vec4 normal_left, cgl::vec4 normal_right,
-		cgl::vec3 uv_left, cgl::vec3 uv_right);
+		typename C::Color color_left, typename C::Color color_right,
+		typename C::Normal normal_left, typename C::Normal normal_right,
+		typename C::UV uv_left, typename C::UV uv_right,
+		typename C::Bary bary_left, typename C::Bary bary_right,
+		const typename C::UV& uv_ddx, const typename C::UV& uv_ddy,
+		const TileRect& rect,
+		unsigned int triangleId);
+
+	// Mip level of a 2x2 quad from the UVs of one of its pixels and their change one
+	// pixel right and one pixel down, all still divided by w. One log2 for the quad
+	template <typename C>
+	static float QuadLod(const typename C::UV& uvPC, const typename C::UV& ddxPC, const typename C::UV& ddyPC, const Texture* texture);
+
+	// Fragment stage of the batch, textures are sampled for all its fragments at
+	// once before lighting. Writes the frame buffer and empties the batch
+	template <typename C>
+	static void ShadeBatch(FragmentBatch<C>& batch, const Texture* texture);
+	template <typename C>
+	static cgl::vec3 LightFragment(const cgl::vec3& color, const typename C::Normal& pixelNormalPC);
+
+	template <typename C>
+	static void ShadeSample(const RasterTriangle& triangle, const VisibilityQuad& quad, const cgl::vec3& stepX, const cgl::vec3& stepY);
+
+	// Shades the pixels of the visibility buffer written by the current draw
+	static void ShadeVisibilityBuffer(const TileRect& rect);
+
+	// Hierarchical z buffer
+	static TileRect HiZBlocks(const RasterTriangle& triangle, const TileRect& rect);
+	static bool IsOccluded(const RasterTriangle& triangle, const TileRect& rect);
+	static void UpdateHiZ(const RasterTriangle& triangle, const TileRect& rect);
+	static void MarkHiZ(int x, int y) { m_HiZDirty.set(y / HIZ_BLOCK_SIZE, x / HIZ_BLOCK_SIZE, 1); }
+
+	// Debug capture, only counted while capturing
+	static void BeginCapture(bool enabled);
+	static void CountOverdraw(int x, int y) { if (m_IsCapturing) ++m_Overdraw[(size_t)y * m_screenWidth + x]; }
+	static void DrawHeatmap(HEATMAP heatmap);
+	static bool DumpCapture(const std::string& path);
+
+	// Empties the transient buffers and gives their memory back to the arena
+	static void ResetArena(size_t vertexCount, size_t triangleCount);
+
+	static void ResizeTiles();
+	// Range of tiles covered by the triangle, in tiles instead of pixels
+	static TileRect TileBounds(const RasterTriangle& triangle);
+	static void BinTriangles();
+	// Returns the heap allocations made by the tile workers other than the caller
+	static size_t RasterizeTiles();
 
 	inline static SHADING m_Shading;
 	inline static PRIMITIVE m_Primitive;
 	inline static Texture::Filtering m_Filtering;
 	inline static bool m_ShowTexture;
-
-	inline static std::shared_ptr<Texture> m_CurrentTexture;
+	inline static TRAVERSAL m_Traversal = TRAVERSAL::SCANLINE;
+	inline static bool m_IsFrustumCulling = true;
 
 	inline static DirectionalLight m_DirectionalLight;
 
 	inline static unsigned int m_screenWidth;
 	inline static unsigned int m_screenHeight;
 
-	inline static std::unique_ptr<Texture> m_TextureToDrawOn;
-	inline static std::unique_ptr<ViewPort> m_ViewportToDrawOn;
+	inline static Pixel m_ClearColor = Pixel{ 255,255,255,255 };
+	inline static FrameBuffer m_FrameBuffer;
+	inline static DepthBuffer m_DepthBuffer;
+
+	// Deferred shading, every pixel written by the draw is reset to empty once shaded
+	inline static bool m_IsDeferred = false;
+	inline static cgl::mat<VisibilitySample> m_VisibilityBuffer;
+
+	// Farthest depth of every block of the z buffer, blocks written by the
+	// triangle being rasterized are marked dirty and refreshed after it
+	inline static bool m_IsHiZEnabled = true;
+	inline static cgl::mat<float> m_HiZ;
+	inline static cgl::mat<unsigned char> m_HiZDirty;
 
-	inline static Pixel m_ClearColor = Pixel{ 255,255,255 };
-	inline static cgl::mat<Pixel> m_FrameBuffer;
-	inline static cgl::mat<float> m_ZBuffer;
+	// Batched transform output of the mesh being processed
+	inline static cgl::vec4_soa m_ClipStream;
+	inline static cgl::vec4_soa m_ScreenStream;
+	inline static cgl::vec4_soa m_NormalStream;
+
+	// Everything that only lives during a draw, reset when the next one starts
+	inline static FrameArena m_Arena;
+	inline static size_t m_HeapAllocations = 0;
+	// Seconds of the last RenderFrame, published with its frame
+	inline static double m_RenderTime = 0.0;
+
+	// Post-transform vertex streams of the current draw, one entry per mesh vertex
+	inline static ArenaVector<cgl::vec4> m_Vertices{ &m_Arena };
+	inline static ArenaVector<cgl::vec4> m_Colors{ &m_Arena };
+	inline static ArenaVector<cgl::vec4> m_Normals{ &m_Arena };
+	inline static ArenaVector<cgl::vec3> m_UVs{ &m_Arena };
+	inline static ArenaVector<RasterTriangle> m_Triangles{ &m_Arena };
+
+	inline static bool m_IsTiled = false;
+	inline static unsigned int m_ThreadCount = GetMaxThreadCount();
+	inline static unsigned int m_TileSize = 64;
+	inline static unsigned int m_TilesX = 0;
+	inline static unsigned int m_TilesY = 0;
+	inline static std::vector<Tile> m_Tiles;
+
+	// Indexed by whether the triangle has a texture
+	inline static std::array<RasterizeKernel, 2> m_RasterizeKernels;
+	inline static std::array<ShadeKernel, 2> m_ShadeKernels;
 
 	inline static Timer timer_fragment_shader;
-};
\ No newline at end of file
+
+	// Fragment work of each worker thread during the draw, padded so no two share a cache line
+	struct alignas(64) ThreadStatistics : PipelineStatistics {};
+	inline static std::vector<ThreadStatistics> m_ThreadStatistics = std::vector<ThreadStatistics>(GetMaxThreadCount());
+	// Debug capture of the frame, overdraw is indexed like the frame buffer rows
+	// and tile costs are in nanoseconds
+	inline static bool m_IsCapturing = false;
+	inline static std::vector<uint32_t> m_Overdraw;
+	inline static std::vector<uint64_t> m_TileCost;
+
+	// Counters of the draw being processed, and of the finished draws of the frame
+	inline static PipelineStatistics m_DrawStatistics;
+	inline static std::vector<PipelineStatistics> m_FrameDraws;
+
+	// Asynchronous rendering, everything below the mutex is shared with the render thread
+	inline static bool m_IsAsync = false;
+	inline static std::thread m_RenderThread;
+	inline static std::mutex m_FrameMutex;
+	inline static std::condition_variable m_FrameSubmitted;
+	inline static std::condition_variable m_FrameRendered;
+	inline static unsigned int m_QueueDepth = 1;
+	inline static std::deque<PendingFrame> m_PendingFrames;
+	inline static bool m_IsRendering = false;
+	inline static bool m_StopRenderThread = false;
+
+	// Last finished frame, waiting for Present()
+	inline static FrameBuffer m_ReadyBuffer;
+	inline static bool m_IsReady = false;
+	inline static uint64_t m_ReadyFrame = 0;
+	inline static std::chrono::steady_clock::time_point m_ReadySubmitted;
+	inline static RasterizerStats m_ReadyStats;
+
+	// Main thread only
+	inline static uint64_t m_SubmittedFrames = 0;
+	inline static uint64_t m_PresentedFrame = 0;
+	inline static uint64_t m_DroppedFrames = 0;
+	inline static double m_FrameLatency = 0.0;
+	inline static double m_UploadTime = 0.0;
+	inline static RasterizerStats m_Stats;
+	inline static size_t m_SubmittedPixels = 0;
+
+	// Presentation is the only part that owns GL objects, they are defined in
+	// present.cpp so the rest of the rasterizer builds without a GL context
+	static std::unique_ptr<Texture> m_TextureToDrawOn;
+	static std::unique_ptr<ViewPort> m_ViewportToDrawOn;
+
+	// Slots of the ring are either held by one of the frame buffers, free, or
+	// waiting for their upload to finish
+	inline static bool m_IsPixelBufferPresentation = false;
+	static std::unique_ptr<PixelBufferRing> m_PixelBuffers;
+	inline static std::vector<int> m_FreeSlots;
+	inline static std::deque<int> m_UploadingSlots;
+};
+
+template <DEPTH_FORMAT Z, SHADING S, typename _F>
+auto Rasterizer::SelectFiltering(bool textured, _F&& kernel)
+{
+	using enum Texture::Filtering;
+
+	// Without a texture the filter is never used
+	if (!textured)
+		return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Triangle, S, NEAREST_NEIGHBOR, false, false>>();
+
+	switch (m_Filtering)
+	{
+	case BILINEAR:   return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Triangle, S, BILINEAR,   true, false>>();
+	case BICUBIC:    return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Triangle, S, BICUBIC,    true, false>>();
+	case TRILLINEAR: return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Triangle, S, TRILLINEAR, true, false>>();
+	default:         return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Triangle, S, NEAREST_NEIGHBOR, true, false>>();
+	}
+}
+
+template <typename _F>
+auto Rasterizer::SelectKernel(bool textured, bool deferred, _F&& kernel)
+{
+	switch (m_DepthBuffer.format())
+	{
+	case DEPTH_FORMAT::FLOAT32_REVERSED: return SelectKernel<DEPTH_FORMAT::FLOAT32_REVERSED>(textured, deferred, kernel);
+	case DEPTH_FORMAT::UNORM24:          return SelectKernel<DEPTH_FORMAT::UNORM24>(textured, deferred, kernel);
+	case DEPTH_FORMAT::UNORM16:          return SelectKernel<DEPTH_FORMAT::UNORM16>(textured, deferred, kernel);
+	default:                             return SelectKernel<DEPTH_FORMAT::FLOAT32>(textured, deferred, kernel);
+	}
+}
+
+template <DEPTH_FORMAT Z, typename _F>
+auto Rasterizer::SelectKernel(bool textured, bool deferred, _F&& kernel)
+{
+	using enum Texture::Filtering;
+
+	// Points and wireframe only write the vertex colors and the visibility
+	// pass only depth and barycentrics, so each has a single kernel
+	if (m_Primitive == PRIMITIVE::Point)
+		return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Point, SHADING::NONE, NEAREST_NEIGHBOR, false, false>>();
+	if (m_Primitive == PRIMITIVE::WireFrame)
+		return kernel.template operator()<KernelConfig<Z, PRIMITIVE::WireFrame, SHADING::NONE, NEAREST_NEIGHBOR, false, false>>();
+	if (deferred)
+		return kernel.template operator()<KernelConfig<Z, PRIMITIVE::Triangle, SHADING::NONE, NEAREST_NEIGHBOR, false, true>>();
+
+	return SelectShading<Z>(textured, kernel);
+}
+
+template <DEPTH_FORMAT Z, typename _F>
+auto Rasterizer::SelectShading(bool textured, _F&& kernel)
+{
+	switch (m_Shading)
+	{
+	case SHADING::GOURAUD: return SelectFiltering<Z, SHADING::GOURAUD>(textured, kernel);
+	case SHADING::PHONG:   return SelectFiltering<Z, SHADING::PHONG>(textured, kernel);
+	default:               return SelectFiltering<Z, SHADING::NONE>(textured, kernel);
+	}
+}
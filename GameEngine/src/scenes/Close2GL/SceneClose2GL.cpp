@@ -1,37 +1,6 @@
 #include "SceneClose2GL.h"
 #include "Lines.hpp"
 
-struct BoundingVolume
-{
-    glm::vec3 max{ 0.f,0.f,0.f };
-    glm::vec3 min{ 0.f,0.f,0.f };
-};
-
-BoundingVolume CalculateEnclosingAABB(const std::unique_ptr<Model>& obj)
-{
-    BoundingVolume r;
-    for (const auto& mesh : obj->meshes)
-    {
-        for (const auto& vertice : mesh.vertices)
-        {
-            if (vertice.Position.x < r.min.x)
-                r.min.x = vertice.Position.x;
-            if (vertice.Position.y < r.min.y)
-                r.min.y = vertice.Position.y;
-            if (vertice.Position.z < r.min.z)
-                r.min.z = vertice.Position.z;
-
-            if (vertice.Position.x > r.max.x)
-                r.max.x = vertice.Position.x;
-            if (vertice.Position.y > r.max.y)
-                r.max.y = vertice.Position.y;
-            if (vertice.Position.z > r.max.z)
-                r.max.z = vertice.Position.z;
-        }
-    }
-    return r;
-}
-
 SceneClose2GL::SceneClose2GL()
     :
     OpenGLShader("resources/shaders/ogl_vertex.shader", "resources/shaders/ogl_fragment.shader"),
@@ -54,7 +23,11 @@ SceneClose2GL::SceneClose2GL()
     FragmentColoringTextureIndex = OpenGLShader.GetSubroutineIndex(ShaderStage::FRAGMENT, "TextureColor");
 }
 
-SceneClose2GL::~SceneClose2GL() = default;
+SceneClose2GL::~SceneClose2GL()
+{
+    // The render thread may still be drawing the models
+    Rasterizer::SetAsync(false, 1);
+}
 
 void SceneClose2GL::OnUpdate(float deltaTime)
 {
@@ -101,36 +74,54 @@ void SceneClose2GL::OnUpdate(float deltaTime)
             OpenGLShader.SetUniformLight(spotlight, ShaderStage::FRAGMENT);
         }
 
+        glm::mat4 viewProjection = oglCamera.GetProjectionMatrix((float)*screenWidth / (float)*screenHeight) * oglCamera.GetViewMatrix();
+
         for (int i = 0; i < objects.size(); ++i)
         {
-            objects[i]->Draw(OpenGLShader, drawPrimitive);
+            objects[i]->Draw(OpenGLShader, drawPrimitive, isFrustumCulling ? &viewProjection : nullptr);
         }
     }
     else
     {
-        Rasterizer::SetViewPort(*screenWidth, *screenHeight);
-        Pixel clearColor{ (unsigned char)(imguiClearColor[0] * 255), (unsigned char)(imguiClearColor[1] * 255), (unsigned char)(imguiClearColor[2] * 255) };
-        Rasterizer::SetClearColor(clearColor);
-        Rasterizer::ClearFrameBuffer();
-        Rasterizer::ClearZBuffer();
+        constexpr unsigned int tileSizes[] = { 16, 32, 64, 128 };
+        Rasterizer::SetAsync(isAsyncRendering, asyncQueueDepth);
+        Rasterizer::SetPixelBufferPresentation(isPixelBufferPresentation);
 
         cgl::vec3 lookAtLocation = !objects.empty() ? objects[selectedLookAt]->transform.position : cgl::vec3();
         isLookAt ? cglCamera.SetLookAt(lookAtLocation) : cglCamera.UnSetLookAt();
 
-        for (const auto& object : objects)
+        RasterizerFrame frame;
+        frame.width = *screenWidth;
+        frame.height = *screenHeight;
+        frame.clearColor = { (unsigned char)(imguiClearColor[0] * 255), (unsigned char)(imguiClearColor[1] * 255), (unsigned char)(imguiClearColor[2] * 255), 255 };
+        frame.isTiled = isTiledRasterizer;
+        frame.threadCount = rasterizerThreads;
+        frame.tileSize = tileSizes[selectedTileSize];
+        frame.traversal = traversal;
+        frame.isHiZ = isHiZ;
+        frame.isFrustumCulling = isFrustumCulling;
+        frame.isDeferred = isDeferredShading;
+        frame.depthFormat = (DEPTH_FORMAT)selectedDepthFormat;
+        frame.heatmap = (HEATMAP)selectedHeatmap;
+        if (isDumpingCapture)
         {
-            Rasterizer::DrawSoftwareRasterized(
-                *object, 
-                cglCamera, 
-                dirLight, 
-                drawPrimitive,
-                shading,
-                showTexture,
-                isEnableCullFace, 
-                isCullingClockWise,
-                textureFilter
-            );
+            frame.capturePath = "close2gl_capture_" + std::to_string(captureCount++);
+            isDumpingCapture = false;
         }
+        frame.camera = cglCamera;
+        frame.light = dirLight;
+        frame.primitive = drawPrimitive;
+        frame.shading = shading;
+        frame.showTextures = showTexture;
+        frame.isCulling = isEnableCullFace;
+        frame.isCullingClockWise = isCullingClockWise;
+        frame.filtering = textureFilter;
+
+        for (const auto& object : objects)
+            frame.draws.push_back({ object.get(), object->transform });
+
+        Rasterizer::SubmitFrame(std::move(frame));
+        Rasterizer::Present();
     }
 
     if(isLightFixedToCamera)
@@ -178,7 +169,93 @@ void SceneClose2GL::OnImGuiRender()
     if (!isOpenGLRendered)
     {
         ImGui::TextColored(ImVec4(0.51f, 0.82f, 0.345f, 1.0f), "Fragment Shader take %.2f ms", Rasterizer::GetTexturingTime() * 1000);
+        ImGui::TextColored(ImVec4(0.51f, 0.82f, 0.345f, 1.0f), "Heap allocations per draw %zu, arena %.2f MB", Rasterizer::GetHeapAllocations(), Rasterizer::GetArenaUsage() / (1024.0f * 1024.0f));
+        ImGui::TextColored(ImVec4(0.51f, 0.82f, 0.345f, 1.0f), "Frame latency %.2f ms, %llu frames in flight, %llu dropped", Rasterizer::GetFrameLatency() * 1000, (unsigned long long)Rasterizer::GetFramesInFlight(), (unsigned long long)Rasterizer::GetDroppedFrames());
+        if (ImGui::TreeNode("Pipeline Statistics"))
+        {
+            // Tables have a limited number of columns, the first draws are enough to compare
+            const auto& allDraws = Rasterizer::GetDrawStatistics();
+            const std::span<const PipelineStatistics> draws(allDraws.data(), std::min<size_t>(allDraws.size(), 32));
+            if (ImGui::BeginTable("PipelineStatistics", 2 + (int)draws.size(), ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollX))
+            {
+                ImGui::TableSetupColumn("Counter");
+                ImGui::TableSetupColumn("Frame");
+                for (size_t i = 0; i < draws.size(); ++i)
+                    ImGui::TableSetupColumn(("Draw " + std::to_string(i)).c_str());
+                ImGui::TableHeadersRow();
+
+                auto row = [&](const char* label, auto counter)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(label);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long)counter(Rasterizer::GetPipelineStatistics()));
+                    for (const auto& draw : draws)
+                    {
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%llu", (unsigned long long)counter(draw));
+                    }
+                };
+
+                row("Vertices in",          [](const PipelineStatistics& s) { return s.verticesIn; });
+                row("Triangles clipped",    [](const PipelineStatistics& s) { return s.trianglesClipped; });
+                row("Triangles culled",     [](const PipelineStatistics& s) { return s.trianglesCulled; });
+                row("Triangles rasterized", [](const PipelineStatistics& s) { return s.trianglesRasterized; });
+                row("Fragments generated",  [](const PipelineStatistics& s) { return s.fragmentsGenerated; });
+                row("Depth test passes",    [](const PipelineStatistics& s) { return s.depthPasses; });
+                row("Depth test fails",     [](const PipelineStatistics& s) { return s.depthFails; });
+                row("Texels nearest",       [](const PipelineStatistics& s) { return s.texelsFetched[FilteringIndex(Texture::Filtering::NEAREST_NEIGHBOR)]; });
+                row("Texels bilinear",      [](const PipelineStatistics& s) { return s.texelsFetched[FilteringIndex(Texture::Filtering::BILINEAR)]; });
+                row("Texels bicubic",       [](const PipelineStatistics& s) { return s.texelsFetched[FilteringIndex(Texture::Filtering::BICUBIC)]; });
+                row("Texels trilinear",     [](const PipelineStatistics& s) { return s.texelsFetched[FilteringIndex(Texture::Filtering::TRILLINEAR)]; });
+                row("Pixels written",       [](const PipelineStatistics& s) { return s.pixelsWritten; });
+
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+        ImGui::Checkbox("Asynchronous Rendering", &isAsyncRendering);
+        if (isAsyncRendering)
+        {
+            ImGui::SliderInt("Queue Depth", &asyncQueueDepth, 1, 3);
+        }
+        ImGui::Checkbox("Pixel Buffer Presentation", &isPixelBufferPresentation);
+        if (isPixelBufferPresentation && !Rasterizer::IsPixelBufferPresentation())
+        {
+            ImGui::TextColored(ImVec4(0.82f, 0.51f, 0.345f, 1.0f), "Needs OpenGL 4.4 or ARB_buffer_storage");
+        }
         ImGui::ColorEdit3(std::string("Close2GL Clear Color").c_str(), imguiClearColor);
+        if (ImGui::RadioButton("Scanline", traversal == TRAVERSAL::SCANLINE))
+        {
+            traversal = TRAVERSAL::SCANLINE;
+        }
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Half-Space", traversal == TRAVERSAL::HALF_SPACE))
+        {
+            traversal = TRAVERSAL::HALF_SPACE;
+        }
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Sub-Pixel", traversal == TRAVERSAL::HALF_SPACE_SUBPIXEL))
+        {
+            traversal = TRAVERSAL::HALF_SPACE_SUBPIXEL;
+        }
+        ImGui::Checkbox("Tiled Rasterizer", &isTiledRasterizer);
+        if (isTiledRasterizer)
+        {
+            const char* tileSizes[]{ "16x16", "32x32", "64x64", "128x128" };
+            ImGui::SliderInt("Threads", &rasterizerThreads, 1, (int)Rasterizer::GetMaxThreadCount());
+            ImGui::Combo("Tile Size", &selectedTileSize, tileSizes, 4);
+        }
+        ImGui::Checkbox("Hierarchical Z", &isHiZ);
+        ImGui::Checkbox("Deferred Shading", &isDeferredShading);
+        const char* depthFormats[]{ "Float 32", "Reversed Float 32", "Unorm 24", "Unorm 16" };
+        ImGui::Combo("Depth Format", &selectedDepthFormat, depthFormats, 4);
+        const char* heatmaps[]{ "None", "Overdraw", "Tile Cost" };
+        ImGui::Combo("Heatmap", &selectedHeatmap, heatmaps, 3);
+        ImGui::SameLine();
+        if (ImGui::Button("Dump Capture"))
+            isDumpingCapture = true;
     }
 
     ImGui::Separator();
@@ -249,6 +326,8 @@ void SceneClose2GL::OnImGuiRender()
     ImGui::Separator();
     ImGui::Checkbox("Fix directional light to Camera", &isLightFixedToCamera);
     ImGui::Separator();
+    ImGui::Checkbox("Frustum Culling", &isFrustumCulling);
+    ImGui::Separator();
     if (ImGui::Checkbox("Culling BackFace", &isEnableCullFace))
     {
         if (isEnableCullFace && isOpenGLRendered)
@@ -312,6 +391,8 @@ void SceneClose2GL::OnImGuiRender()
 
         if (ImGui::Button(std::string("Delete " + (*it)->name).c_str()))
         {
+            // Queued frames still draw it
+            Rasterizer::WaitIdle();
             it = objects.erase(it);
         }
         else
@@ -347,8 +428,8 @@ void SceneClose2GL::AddObject(std::string_view label)
     else if (label == "SPONZA_CRYTEK")
         objects.emplace_back(std::make_unique<Model>("resources/models/sponza_cry/sponza.obj", tri));
 
-    // Calculate AABB
-    BoundingVolume aabb = CalculateEnclosingAABB(objects.back());
+    // Bounds are cached by the model when it is loaded
+    const BoundingBox& aabb = objects.back()->bounds;
 
     float aspectRatio = (float)*pScreenWidth / (float)*pScreenHeight;
 
@@ -53,6 +53,7 @@ private:
 
 	bool isOpenGLRendered = true;
 	bool isEnableCullFace = false;
+	bool isFrustumCulling = true;
 
 	bool isCullingClockWise = false;
 	bool isLoadingClockWise = false;
@@ -79,6 +80,22 @@ private:
 
 	float imguiClearColor[3] = { 1.0f,1.0f,1.0f };
 
+	TRAVERSAL traversal = TRAVERSAL::SCANLINE;
+
+	bool isTiledRasterizer = false;
+	bool isHiZ = true;
+	bool isDeferredShading = false;
+	int rasterizerThreads = (int)Rasterizer::GetMaxThreadCount();
+	int selectedTileSize = 2;
+	int selectedDepthFormat = 0;
+	bool isAsyncRendering = false;
+	int asyncQueueDepth = 1;
+	bool isPixelBufferPresentation = true;
+	int selectedHeatmap = 0;
+	// Set for one frame by the dump button
+	bool isDumpingCapture = false;
+	unsigned int captureCount = 0;
+
 	bool isLookAt = false;
 	unsigned int selectedLookAt = 0;
 };
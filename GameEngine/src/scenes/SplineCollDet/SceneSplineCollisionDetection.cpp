@@ -86,7 +86,10 @@ void SceneSplineCollisionDetection::OnUpdate(float deltaTime)
 
     collDetTimer.reset_hard();
     if (hasCollisionDetection)
+    {
+        PROFILE_SCOPE("Collision Check");
         collDet.CollisionCheck(*(endoSplineModel.get()), *(colonSplineModel.get()));
+    }
     collDetTimer.stop();
 
     view = pCamera.GetViewMatrix();